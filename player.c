@@ -1,8 +1,22 @@
 // add the needed C libraries below
+#if defined(DECISION_STATS) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE // syscall and clock_gettime, which -std=c99 hides
+#endif
 #include <stdbool.h> // bool, true, false
 #include <stdlib.h> // rand, malloc, realloc, free
 #include <stdio.h> // printf
-#include <string.h> // memset
+#include <string.h> // memset, memcmp
+#include <limits.h> // INT_MAX
+#include <pthread.h> // pthread_create, pthread_join
+#include <unistd.h> // sysconf
+#ifdef DECISION_STATS
+#include <time.h> // clock_gettime
+#ifdef __linux__
+#include <linux/perf_event.h> // perf_event_attr
+#include <sys/ioctl.h> // ioctl
+#include <sys/syscall.h> // SYS_perf_event_open
+#endif
+#endif
 
 // look at the file below for the definition of the direction type
 // pacman.h must not be modified!
@@ -29,6 +43,172 @@ const char * binome="Feraux, Elain";
 
 // put the prototypes of your additional functions/procedures below
 
+// ***********************************************************************************
+// Map dimensions types declaration
+// ***********************************************************************************
+
+// The largest map the AI is built for, in number of positions, and the largest width
+// or height (e.g. -DMAP_MAX_CELLS=250000 for 500x500 maps). The positions and the
+// coordinates are stored on 16 bits while they fit, so that the searches go through
+// less memory; above that, they are stored on 32 bits.
+#ifndef MAP_MAX_CELLS
+#define MAP_MAX_CELLS 65535
+#endif
+
+#ifndef MAP_MAX_SIDE
+#define MAP_MAX_SIDE 32767
+#endif
+
+// The index of a position or of a node, or a number of steps between two of them.
+#if MAP_MAX_CELLS <= 0xffff
+typedef unsigned short map_index;
+#define MAP_INDEX_NONE 0xffffu
+#else
+typedef unsigned int map_index;
+#define MAP_INDEX_NONE 0xffffffffu
+#endif
+
+// A coordinate of a position. Entities that could not be located are given
+// negative coordinates.
+#if MAP_MAX_SIDE <= 0x7fff
+typedef short map_coord;
+#else
+typedef int map_coord;
+#endif
+
+// A weighted distance. A path through a few ghosts already weighs more than 255, and
+// a path across a large map more than 65535: distances are always stored on 32 bits.
+typedef int map_distance;
+
+// ***********************************************************************************
+// Memory management structures & functions declaration
+// ***********************************************************************************
+
+// Counters of the calls made to the system allocator, to keep track of how much
+// allocation work a call to the pacman function does.
+typedef struct
+{
+    unsigned long mallocs;
+    unsigned long reallocs;
+    unsigned long frees;
+} allocation_counters;
+
+// The counters are global: every allocation of the AI goes through the functions below.
+// They are never cleared, so that a tool reads the allocations made between two points
+// by taking the difference.
+allocation_counters allocations;
+
+#ifdef ALLOCATION_STATS
+// The allocations of the last call of the pacman function, and their sum since the
+// totals were last cleared, e.g. at the start of a game. Nothing is printed: the tools
+// read them (e.g. tools/decision_profile).
+allocation_counters allocation_last;
+allocation_counters allocation_totals;
+#endif
+
+/**
+ * @brief Allocate memory with malloc, counting the call.
+ * @param size The number of bytes to allocate
+ * @return The allocated memory, NULL on failure
+ */
+void* tracked_malloc(size_t size);
+
+/**
+ * @brief Resize memory with realloc, counting the call.
+ * @param ptr The memory to resize, may be NULL
+ * @param size The new number of bytes
+ * @return The resized memory, NULL on failure
+ */
+void* tracked_realloc(void* ptr, size_t size);
+
+/**
+ * @brief Release memory with free, counting the call.
+ * @param ptr The memory to release, may be NULL
+ */
+void tracked_free(void* ptr);
+
+// ***********************************************************************************
+// Instrumentation structures & functions declaration
+// ***********************************************************************************
+
+// Compiling with -DDECISION_STATS times the phases of each call of the pacman function,
+// reads the hardware counters around them where the system allows it, and counts the
+// work done by the searches. Otherwise, the instrumentation compiles to nothing.
+#ifdef DECISION_STATS
+
+// The phases of a decision.
+typedef enum
+{
+    PHASE_CREATE, // Creating the AI engine, or acquiring it in the persistent mode
+    PHASE_INITIALISE, // Finding the entities and computing the threat field
+    PHASE_UPDATE_GRAPH, // Bringing the weights of the graph up to date, before each search
+    PHASE_SHORTEST_PATHS, // Each batch of shortest paths
+    PHASE_NEXT_MOVE, // Turning the target into a direction
+    PHASE_COUNT
+} decision_phase;
+
+// What the runs of a phase cost, summed.
+typedef struct
+{
+    unsigned long runs;
+    unsigned long long ns; // Wall time
+    unsigned long long cycles; // The hardware counters stay at 0 if they cannot be read
+    unsigned long long instructions;
+    unsigned long long cache_misses;
+} phase_stats;
+
+// What one or several decisions cost.
+typedef struct
+{
+    unsigned long decisions;
+    phase_stats phases[PHASE_COUNT];
+    unsigned long pushes; // Into the priority queues
+    unsigned long pops; // Out of the priority queues
+    unsigned long expanded; // The nodes settled by the searches
+    unsigned long searches; // The searches run: Dijkstra, A*, flood fills...
+    bool hardware; // Whether the hardware counters were read
+} decision_stats;
+
+// The last call of the pacman function, and the sum of the calls since the totals were
+// last cleared, e.g. at the start of a game.
+decision_stats decision_last;
+decision_stats decision_totals;
+
+/**
+ * @brief Start timing a phase of the current decision.
+ * @param p The phase
+ */
+void decision_stats_begin(decision_phase p);
+
+/**
+ * @brief Stop timing a phase, adding what it cost to the current decision.
+ * @param p The phase
+ */
+void decision_stats_end(decision_phase p);
+
+/**
+ * @brief Add what decisions cost to a sum.
+ * @param to The sum
+ * @param s The decisions to add
+ */
+void decision_stats_add(decision_stats* to, const decision_stats* s);
+
+/**
+ * @brief Name a phase.
+ * @param p The phase
+ * @return Its name
+ */
+const char* decision_phase_name(decision_phase p);
+
+#define DECISION_PHASE_BEGIN(p) decision_stats_begin(p)
+#define DECISION_PHASE_END(p) decision_stats_end(p)
+#define DECISION_COUNT(counter) (decision_last.counter++)
+#else
+#define DECISION_PHASE_BEGIN(p) ((void)0)
+#define DECISION_PHASE_END(p) ((void)0)
+#define DECISION_COUNT(counter) ((void)0)
+#endif
+
 // ***********************************************************************************
 // Linked list structures & functions declaration
 // ***********************************************************************************
@@ -36,8 +216,8 @@ const char * binome="Feraux, Elain";
 // A "graph node" is the value being held by the list.
 typedef struct
 {
-    int index;
-    int weight;
+    map_index index;
+    map_distance weight;
 } value;
 
 // The base type denoting a node in the list.
@@ -47,13 +227,55 @@ typedef struct node
     struct node* next;
 } node;
 
-// The base structure representing the linked list.
+// The nodes are not allocated one by one: they are carved out of slabs holding
+// many nodes at once, allocated as the list grows. A removed node goes to a free
+// list threaded through its `next` field, and is reused by the next insertion.
+#define NODE_POOL_SLAB_SIZE 128
+
+// A block of nodes, allocated in one go.
+typedef struct node_slab
+{
+    struct node_slab* next;
+    node nodes[NODE_POOL_SLAB_SIZE];
+} node_slab;
+
+// The pool handing out the nodes of a list.
+typedef struct
+{
+    node_slab* slabs; // The slabs allocated so far, the most recent first
+    int used; // The number of nodes handed out from the most recent slab
+    node* free_nodes; // The nodes given back, linked by their `next` field
+} node_pool;
+
+// The base structure representing the linked list, which owns its nodes' pool.
 typedef struct
 {
     node* first;
     int size;
+    node_pool pool;
 } list;
 
+/**
+ * @brief Get a node from the pool, reusing a released one if possible, or
+ * allocating a new slab if every node is in use.
+ * @param p The pool to take the node from
+ * @return A node, NULL if a new slab could not be allocated
+ */
+node* node_pool_acquire(node_pool* p);
+
+/**
+ * @brief Give back a node to the pool, so it can be reused.
+ * @param p The pool the node was taken from
+ * @param n The node to give back
+ */
+void node_pool_release(node_pool* p, node* n);
+
+/**
+ * @brief Free all the slabs of the pool at once, whether their nodes are in use or not.
+ * @param p The pool to empty
+ */
+void node_pool_release_all(node_pool* p);
+
 // This type is useful when iterating over the linked list
 // (i.e. provides useful abstractions for basic operations).
 typedef struct
@@ -68,7 +290,7 @@ typedef struct
  */
 list* list_new();
 /**
- * @brief Delete a list, freeing all its nodes.
+ * @brief Delete a list, freeing all its nodes at once with the slabs of its pool.
  * @param l The list to delete
  */
 void list_delete(list* l);
@@ -143,6 +365,22 @@ value list_iterator_get(list_iterator it);
 // Priority queue structures & functions declaration
 // ***********************************************************************************
 
+// The priority queue can be built on three different data structures, selected at
+// compile time (e.g. -DPRIORITY_QUEUE_IMPL=PRIORITY_QUEUE_LIST):
+//      - a linked list kept sorted, where each push is linear in the queue size;
+//      - an indexed binary heap, where each push and pop is logarithmic;
+//      - a circular array of buckets (Dial's algorithm), where each push and pop
+//        is constant time.
+#define PRIORITY_QUEUE_LIST 0
+#define PRIORITY_QUEUE_HEAP 1
+#define PRIORITY_QUEUE_BUCKETS 2
+
+#ifndef PRIORITY_QUEUE_IMPL
+#define PRIORITY_QUEUE_IMPL PRIORITY_QUEUE_HEAP
+#endif
+
+#if PRIORITY_QUEUE_IMPL == PRIORITY_QUEUE_LIST
+
 // A priority queue is defined as a list, using the definition above, with a
 // comparator used to sort values according to a user-specified criteria.
 typedef struct
@@ -151,6 +389,60 @@ typedef struct
     int (*cmp_func)(value l, value r);
 } priority_queue;
 
+#elif PRIORITY_QUEUE_IMPL == PRIORITY_QUEUE_HEAP
+
+// A priority queue is defined as a binary heap stored in an array: the children
+// of heap[i] are heap[2i+1] and heap[2i+2], and no child is lower than its parent
+// according to the comparator.
+// The heap is indexed by the graph node held in the values: a graph node is never
+// queued twice, pushing it again only decreases its key if the new value is lower.
+// Equal values are popped in the order the sorted list pops them, the value pushed
+// last first, so that the searches settle the positions in the same order whichever
+// the implementation: each value remembers the push that put it in the heap.
+typedef struct
+{
+    value v;
+    unsigned int push; // The number of the push, counted from the last clear
+} heap_entry;
+
+typedef struct
+{
+    heap_entry* heap;
+    int size;
+    int capacity;
+    unsigned int pushes;
+    int* slots; // slots[index] = position in the heap of the graph node `index`, -1 if not queued
+    int slots_capacity;
+    int (*cmp_func)(value l, value r);
+} priority_queue;
+
+#elif PRIORITY_QUEUE_IMPL == PRIORITY_QUEUE_BUCKETS
+
+// The weights in the graph fit in an unsigned char, so when the values are extracted
+// in increasing order of weight (as in the Dijkstra's algorithm), all the values in
+// the queue are within 255 of the lowest one. Each weight can then get its own bucket
+// in a circular array of 256 buckets, going round from the bucket of the lowest weight.
+// The buckets are doubly linked lists threaded through arrays indexed by graph node,
+// so pushing, popping and decreasing a key never allocate.
+// Values are ordered by their weight: the comparator is kept for the API but unused.
+#define PRIORITY_QUEUE_BUCKET_COUNT 256
+
+typedef struct
+{
+    int heads[PRIORITY_QUEUE_BUCKET_COUNT]; // heads[b] = first graph node of bucket b, -1 if empty
+    int* next; // next[index] = graph node following `index` in its bucket
+    int* prev; // prev[index] = graph node preceding `index` in its bucket, -1 for the head
+    int* keys; // keys[index] = weight of the graph node `index`, -1 if not queued
+    int capacity;
+    int size;
+    int lowest; // The lowest weight that may be in the queue
+    int (*cmp_func)(value l, value r);
+} priority_queue;
+
+#else
+#error "Unknown PRIORITY_QUEUE_IMPL"
+#endif
+
 /**
  * @brief Create an empty priority queue, using the specified comparator to sort values.
  * @param cmp A function comparing two values in the priority queue
@@ -164,6 +456,13 @@ priority_queue* priority_queue_new(int(*cmp)(value, value));
  */
 void priority_queue_delete(priority_queue* q);
 
+/**
+ * @brief Remove every element from the priority queue, keeping its memory for
+ * the next use.
+ * @param q The priority queue to empty
+ */
+void priority_queue_clear(priority_queue* q);
+
 /**
  * @brief Get the number of elements in the priority queue.
  * @param q A priority queue
@@ -173,6 +472,10 @@ int priority_queue_size(priority_queue* q);
 
 /**
  * @brief Enqueue a graph node in the priority queue, and sort it.
+ * With the heap and bucket implementations, a graph node already in the queue is not
+ * added twice: its value is replaced only if the new one is lower (decrease-key).
+ * The bucket implementation also requires all the weights in the queue to be within
+ * 255 of each other.
  * @param q The priority queue to add a graph node to
  * @param v The graph node to additional
  */
@@ -194,6 +497,45 @@ int priority_queue_pop(priority_queue* q);
  */
 int priority_queue_top(priority_queue* q, value* v);
 
+#if PRIORITY_QUEUE_IMPL == PRIORITY_QUEUE_HEAP
+/**
+ * @brief Move the value at the given heap position up, until its parent is not greater.
+ * @param q The priority queue to restore the order of
+ * @param i The heap position of the value to move
+ */
+void priority_queue_sift_up(priority_queue* q, int i);
+
+/**
+ * @brief Move the value at the given heap position down, until its children are not lower.
+ * @param q The priority queue to restore the order of
+ * @param i The heap position of the value to move
+ */
+void priority_queue_sift_down(priority_queue* q, int i);
+
+/**
+ * @brief Tell whether a heap entry is popped before another one.
+ * @param q The priority queue holding both entries
+ * @param left An entry
+ * @param right Another entry
+ * @return True if the value of left is lower, or equal but pushed later
+ */
+bool priority_queue_before(priority_queue* q, heap_entry left, heap_entry right);
+#elif PRIORITY_QUEUE_IMPL == PRIORITY_QUEUE_BUCKETS
+/**
+ * @brief Make sure the arrays indexed by graph node can hold the given one.
+ * @param q The priority queue to grow
+ * @param index The graph node about to be pushed
+ */
+void priority_queue_reserve(priority_queue* q, int index);
+
+/**
+ * @brief Detach a queued graph node from its bucket.
+ * @param q The priority queue holding the graph node
+ * @param index The graph node to detach
+ */
+void priority_queue_unlink(priority_queue* q, int index);
+#endif
+
 // ***********************************************************************************
 // Pathfinding structures & functions declaration
 // ***********************************************************************************
@@ -201,8 +543,8 @@ int priority_queue_top(priority_queue* q, value* v);
 // A simple type to denote an x-y position.
 typedef struct
 {
-    int x;
-    int y;
+    map_coord x;
+    map_coord y;
 } vec2;
 
 /**
@@ -256,37 +598,271 @@ typedef struct
  */
 unsigned char get_weight_for_entity(char c, entities_weights weights);
 
+// The map is turned into weights a whole row at a time, with the vector instructions
+// of the machine when there are some, selected at compile time (e.g.
+// -DMAP_KERNEL_IMPL=MAP_KERNEL_SCALAR). By default, the widest instruction set the
+// compiler targets is used: SSE2 comes with every x86-64 machine, AVX2 needs -mavx2.
+#define MAP_KERNEL_SCALAR 0
+#define MAP_KERNEL_SSE2 1
+#define MAP_KERNEL_AVX2 2
+
+#ifndef MAP_KERNEL_IMPL
+#if defined(__AVX2__)
+#define MAP_KERNEL_IMPL MAP_KERNEL_AVX2
+#elif defined(__SSE2__)
+#define MAP_KERNEL_IMPL MAP_KERNEL_SSE2
+#else
+#define MAP_KERNEL_IMPL MAP_KERNEL_SCALAR
+#endif
+#endif
+
+#if MAP_KERNEL_IMPL == MAP_KERNEL_AVX2
+#include <immintrin.h> // __m256i, _mm256_*
+#elif MAP_KERNEL_IMPL == MAP_KERNEL_SSE2
+#include <emmintrin.h> // __m128i, _mm_*
+#elif MAP_KERNEL_IMPL != MAP_KERNEL_SCALAR
+#error "Unknown MAP_KERNEL_IMPL"
+#endif
+
 /**
- * @brief Compute the weights for each neighbor of the specified element. Supports mirroring of
- * the map.
- * @param map The game map
- * @param w The map width
- * @param h The map height
- * @param x The x coordinate of the element
- * @param y The y coordinate of the element
- * @param weight_values The computed weights for all four neighbor, must be a pointer to an 4-element array
+ * @brief Map every character to its weight, once and for all for a given configuration.
  * @param weights The weights to assign to elements, delegated to `get_weight_for_entity`
+ * @param table The weight of every character, must be a pointer to a 256-element array
+ */
+void build_weight_table(entities_weights weights, unsigned char* table);
+
+/**
+ * @brief Give every position of a map row the weight of the entity standing there.
+ * @param row The map row
+ * @param w The map width
+ * @param weights The weights to assign to elements
+ * @param table The same weights, for every character, from `build_weight_table`
+ * @param weight_values The weight of each position of the row, must hold w elements
+ */
+void classify_row(const char* row, int w, entities_weights weights, const unsigned char* table,
+    unsigned char* weight_values);
+
+/**
+ * @brief Pack the weights to go to the four neighbors of every position of a row, as
+ * stored in the graph. Each row of weights is padded with one element on both sides,
+ * holding the weight at the other end of the row, so that the mirroring of the map
+ * borders needs no special case.
+ * @param north The padded weights of the row above
+ * @param row The padded weights of the row
+ * @param south The padded weights of the row below
+ * @param w The map width
+ * @param out The packed weights of the row positions, must hold w elements
  */
-void compute_weights(char** map, int w, int h, int x, int y, char* weight_values, entities_weights weights);
+void pack_neighbor_weights(const unsigned char* north, const unsigned char* row,
+    const unsigned char* south, int w, unsigned int* out);
 
 // A simple type to produce a grouped result of the shortest path, and its length.
 typedef struct
 {
     vec2 next_move;
-    int distance;
-    int size;
+    map_distance distance;
+    map_distance size;
 } path_result;
 
+// The walls never move during a level, so the neighbors of every position Pacman can
+// walk on are computed once, in compressed sparse row form: positions that are not
+// walls get a dense node number, and the neighbors of node k are the nodes
+// targets[offsets[k]] to targets[offsets[k + 1] - 1], reached by going in the matching
+// directions. The mirroring of the map borders is already taken into account.
+typedef struct
+{
+    int node_count;
+    int* cell_to_node; // cell_to_node[k] = node of graph position k, -1 for walls and the Door
+    int* node_to_cell; // node_to_cell[k] = graph position of node k
+    vec2* positions; // positions[k] = x-y position of node k
+    int* offsets;
+    int* targets;
+    unsigned char* directions;
+} adjacency;
+
+// When every position Pacman can walk on costs the same to enter, the shortest paths
+// are the layers of a breadth-first search, which can be grown for 64 positions at a
+// time: the map is seen as rows of 64-bit words, one bit per position, and the next
+// layer is the current one shifted in the four directions, minus the walls and the
+// positions already reached. A layer is kept for each first move out of the source,
+// so that every position reached also knows which way to go.
+typedef struct
+{
+    unsigned long long* walkable; // The positions Pacman can walk on
+    unsigned long long* open; // The positions Pacman can walk on that were not reached yet
+    unsigned long long* frontier; // The last layer, one set of rows per first move
+    unsigned long long* next; // The layer being grown, one set of rows per first move
+    unsigned long long last_word; // The bits of the last word of a row that are on the map
+    int words; // The number of words in a row
+    int w;
+    int h;
+} flood_fill;
+
+// The shortest paths from Pacman can be computed in three ways, selected at compile
+// time (e.g. -DPATHFINDING_IMPL=PATHFINDING_JUNCTION_GRAPH):
+//      - a distance field over every position Pacman can walk on;
+//      - a distance field over the junctions of the maze only, the corridors
+//        between them being contracted into single edges;
+//      - a table of the distances between all the positions, ignoring the entities,
+//        corrected around the positions whose weight is not 1.
+#define PATHFINDING_DISTANCE_FIELD 0
+#define PATHFINDING_JUNCTION_GRAPH 1
+#define PATHFINDING_DISTANCE_TABLE 2
+
+#ifndef PATHFINDING_IMPL
+#define PATHFINDING_IMPL PATHFINDING_DISTANCE_FIELD
+#endif
+
+#if PATHFINDING_IMPL == PATHFINDING_JUNCTION_GRAPH
+
+// A single corridor can cost more than 255 to walk, so the costs of the junction
+// graph do not fit in the window of the buckets.
+#if PRIORITY_QUEUE_IMPL == PRIORITY_QUEUE_BUCKETS
+#error "The junction graph needs a priority queue that accepts any weight"
+#endif
+
+// What the positions inside a corridor hold, as counted by the corridor.
+#define CORRIDOR_PATH 0
+#define CORRIDOR_PELLET 1
+#define CORRIDOR_OCCUPANT 2 // A ghost, an energizer or Pacman
+
+// A corridor is a chain of nodes with exactly two neighbors each, between two
+// junctions (positions with one, three or four neighbors). Its positions are
+// numbered from 0 (the `from` junction) to `length` (the `to` junction).
+typedef struct
+{
+    int from; // The junction at position 0
+    int to; // The junction at position `length`, may be `from` for a loop
+    int length; // The number of steps from one end to the other
+    int first; // Index of position 1 in the `nodes` array of the junction graph
+    int sums; // Index of position 0 in the `costs` and `blocked` arrays of the junction graph
+    int pellets; // The number of Pacgums inside the corridor, ends excluded
+    int occupants; // The number of ghosts, energizers and Pacman inside the corridor, ends excluded
+    bool counted; // Whether its counts were made since the whole graph was last built
+    bool summed; // Whether its sums still hold for the weights of the graph
+} corridor;
+
+// The adjacency with its corridors contracted: a search only visits the junctions,
+// going from one to the next through whole corridors.
+// The positions inside a corridor are reached by adding the cost of the part of the
+// corridor leading to them, which is read from the sums of the weights along it. The sums
+// are made the first time a search needs them, and kept until the weights of the corridor
+// change. Until then, going through the whole of a corridor holding only paths and Pacgums
+// costs what its counts of them weigh, without any sum.
+typedef struct
+{
+    int junction_count;
+    int* junction_to_node; // junction_to_node[k] = node of junction k
+    int* node_to_junction; // node_to_junction[k] = junction of node k, -1 inside a corridor
+    int* node_corridor; // node_corridor[k] = corridor of node k, -1 for the junctions
+    int* node_position; // node_position[k] = position of node k in its corridor
+
+    int corridor_count;
+    corridor* corridors;
+    int* nodes; // The inner nodes of all the corridors, from `from` to `to`
+
+    int* incidence_offsets; // The corridors ending at junction k are the incidences from
+    int* incidences; // incidence_offsets[k], as 2 * corridor (+ 1 if reached by its `to` end)
+
+    // The sums of the summed corridors: costs[sums + i] is the cost of entering every
+    // position up to i, and blocked[sums + i] the number of them that cannot be crossed.
+    int* costs;
+    int* blocked;
+
+    // The counts of a corridor are made from the map the first time a search walks along
+    // it, and then kept up to date from the positions the map tracker finds changed.
+    unsigned char* contents; // contents[k] = what node k holds, if inside a corridor
+    unsigned char table[256]; // The weights the graph was last built with, for every character
+
+    // The source of the last search
+    int source_node;
+    int source_junction; // -1 if the source is inside a corridor
+} junction_graph;
+
+#elif PATHFINDING_IMPL == PATHFINDING_DISTANCE_TABLE
+
+// The table holds node_count^2 distances: above this many nodes, it would not fit
+// in memory and the distance field is used instead.
+#define DISTANCE_TABLE_MAX_NODES 4096
+
+// The table is filled by this many threads at most.
+#define DISTANCE_TABLE_MAX_THREADS 16
+
+// Past this many positions whose weight is not 1, correcting the distances of the
+// table costs more than the distance field.
+#define DISTANCE_TABLE_MAX_PENALTIES 32
+
+// The number of nodes a local search may expand before giving up for the distance field.
+#define DISTANCE_TABLE_SEARCH_BUDGET 128
+
+// The walls never move during a level: the number of steps between any two positions
+// Pacman can walk on is computed once, when the level starts, and kept across the calls.
+// The table is indexed by the nodes of the adjacency.
+typedef struct
+{
+    unsigned int hash; // FNV-1a hash of the walls of the level
+    char* walls; // walls[k] = 1 if graph position k is a wall or the Door
+    int w;
+    int h;
+    int node_count;
+    map_index* distances; // distances[a * node_count + b] = steps from a to b
+} distance_table;
+
+#define DISTANCE_TABLE_UNREACHABLE MAP_INDEX_NONE
+
+#elif PATHFINDING_IMPL != PATHFINDING_DISTANCE_FIELD
+#error "Unknown PATHFINDING_IMPL"
+#endif
+
 // A simple type to hold the internal representation of the graph used by the 
 // following algorithms.
 typedef struct
 {
     unsigned int* ptr;
     char** map;
-    int w;
-    int h;
+    map_coord w;
+    map_coord h;
+    adjacency adj;
+    flood_fill* flood;
+    unsigned char* rows; // Three padded rows of weights for update_graph to work in
+#if PATHFINDING_IMPL == PATHFINDING_JUNCTION_GRAPH
+    junction_graph* junctions;
+#elif PATHFINDING_IMPL == PATHFINDING_DISTANCE_TABLE
+    const distance_table* table; // Shared by every graph of the level, NULL if too large
+#endif
 } graph;
 
+/**
+ * @brief Build the adjacency of the positions Pacman can walk on.
+ * @param map The game map
+ * @param w The map width
+ * @param h The map height
+ * @return The newly created adjacency
+ */
+adjacency create_adjacency(char** map, int w, int h);
+
+/**
+ * @brief A convenience function to delete the adjacency when it is no longer needed.
+ * @param adj The adjacency to dispose of
+ */
+void dispose_adjacency(adjacency adj);
+
+/**
+ * @brief Get the node of the adjacency at the given x-y position.
+ * @param g The graph
+ * @param pos The x-y position, which may be out of the map
+ * @return The node at this position, -1 if there is none (wall, Door, out of the map)
+ */
+int graph_get_node(const graph g, vec2 pos);
+
+/**
+ * @brief Get the weight to enter a node, the same from all of its neighbors.
+ * @param g The graph
+ * @param node The node
+ * @return The weight to enter the node, 255 if it has no neighbor
+ */
+unsigned char graph_get_node_weight(const graph g, int node);
+
 /**
  * @brief Set the weight to go to a given neighbor for the specified graph position.
  * @param g The graph to update
@@ -331,926 +907,4411 @@ graph create_graph(char** map, int w, int h);
  */
 void update_graph(graph g, entities_weights weights);
 
+// With the distance field, the shortest path to a single target can be searched in
+// three ways, selected at compile time (e.g. -DSHORTEST_PATH_IMPL=SHORTEST_PATH_DIJKSTRA):
+//      - the Dijkstra's algorithm, stopping once the target is reached;
+//      - the A* algorithm, going first through the nodes whose distance from the source
+//        plus their toroidal distance to the target is the lowest;
+//      - two Dijkstra's algorithms at once, one from the source and one backwards from
+//        the target, stopping once they have met on the shortest path.
+#define SHORTEST_PATH_DIJKSTRA 0
+#define SHORTEST_PATH_ASTAR 1
+#define SHORTEST_PATH_BIDIRECTIONAL 2
+
+#ifndef SHORTEST_PATH_IMPL
+#define SHORTEST_PATH_IMPL SHORTEST_PATH_ASTAR
+#endif
+
+// The state of a search for a single graph position. Everything the Dijkstra's algorithm
+// needs to know about a position is kept in the same record, so that relaxing an edge
+// touches one cache line instead of one per array.
+typedef struct
+{
+    unsigned int stamp; // The search this record was written by, older records are stale
+    map_distance distance; // The weighted distance from the source, -1 if not reached
+    map_distance size; // The raw size of the path from the source
+    map_index first_step; // The first node to go to from the source
+    bool settled; // True once the shortest distance to this position is final
+} search_record;
+
+// A scratch area, allocated once per AI engine, holding the state of the searches,
+// with one record per node of the adjacency.
+// Instead of clearing every record before a search, each search gets a new stamp:
+// a record whose stamp is not the current one is considered blank.
+typedef struct
+{
+    search_record* records;
+    unsigned int stamp;
+    priority_queue* queue;
+#if SHORTEST_PATH_IMPL == SHORTEST_PATH_BIDIRECTIONAL
+    search_record* back_records; // The records of the search backwards from the target,
+    priority_queue* back_queue; // the first step being the next node towards the target
+#endif
+    int expanded; // The number of nodes settled by the last search
+    int w;
+    int h;
+} search_arena;
+
 /**
- * @brief An implementation fitted for the game of Dijkstra's algorithm to find the shortest path between a source and a target.
- * @param g The graph representing the current game map
- * @param source The begin node to search from
- * @param target The end node, stops the algorithm when it is reached
- * @return The node to go on the next move that shall lead to the shortest path, along with the weighted distance of the path.
+ * @brief Allocate a search arena matching the dimensions of the map.
+ * @param w The map width
+ * @param h The map height
+ * @return The newly created search arena
  */
-path_result shortest_path(const graph g, vec2 source, vec2 target);
+search_arena* search_arena_create(int w, int h);
 
 /**
- * @brief A convenience function to delete the graph when it is no longer needed.
- * @param g The graph to dispose of
+ * @brief Invalidate every record of the arena to start a new search.
+ * @param a The search arena
  */
-void dispose_graph(graph g);
+void search_arena_begin(search_arena* a);
 
 /**
- * @brief The weight comparator used by the priority queue in Dijkstra's algorithm.
- * @param left A value
- * @param right A value
- * @return < 0 if left < right, 0 if left == right, > 0 if left > right
+ * @brief Get the record of the current search for a node, blanking it first
+ * if it was written by an older search.
+ * @param a The search arena
+ * @param idx The node
+ * @return The record of the node
  */
-int compare_weights(value left, value right);
-
-// ***********************************************************************************
-// Entity finder structures & functions
-// ***********************************************************************************
+search_record* search_arena_get(search_arena* a, int idx);
 
+#if SHORTEST_PATH_IMPL == SHORTEST_PATH_BIDIRECTIONAL
 /**
- * @brief Iterate over the map to find the positions of the four ghosts.
- * @param map The game map
- * @param w The map width
- * @param h The map height
- * @param ghosts_pos The positions of the ghosts on the map
+ * @brief Get the record of the current backward search for a node, blanking it first
+ * if it was written by an older search.
+ * @param a The search arena
+ * @param idx The node
+ * @return The backward record of the node
  */
-void find_ghosts(char** map, int w, int h, vec2* ghosts_pos);
-
-// A simple type to represent our findings in the map.
-typedef struct
-{
-    vec2* positions;
-    int count;
-} findings;
+search_record* search_arena_get_back(search_arena* a, int idx);
+#endif
 
 /**
- * @brief Iterate over the map to find the positions of the specified entity.
- * @param map The game map
- * @param w The map width
- * @param h The map height
- * @param entity The entity type to look for
- * @param estimated_number The estimated number of entities there might be on the map
- * @param out A findings structure passed by address to store the result of the search
+ * @brief Read the shortest path to the given target from the records of the last search.
+ * @param g The graph the last search ran on
+ * @param a The search arena used by the last search
+ * @param target The end node of the path
+ * @return The node to go on the next move, the weighted distance and the raw size of the path
  */
-void find_entities(char** map, int w, int h, char entity, int estimated_number, findings* out);
+path_result search_arena_get_path(const graph g, search_arena* a, vec2 target);
 
 /**
- * @brief Convenience function to free the allocated resources created by the findings.
- * @param f The findings to free
+ * @brief Release the memory held by the search arena.
+ * @param a The search arena to destroy
  */
-void dispose_findings(findings f);
-
-// ***********************************************************************************
-// Strategy structures & functions declarations
-// ***********************************************************************************
-
-// A new type to handle the whole context of the AI.
-typedef struct
-{
-    graph g;
-    vec2 pacman;
-    entities_weights weights;
-    
-    findings ghosts;
-    findings energizers;
-    findings virgin_paths;
-    
-    path_result* paths_to_ghosts;
-    path_result* paths_to_energizers;
-    path_result* paths_to_virgin_paths;
-    
-    direction decision;
-} ai_engine;
-
-// A struct to tweak how pacman behaves when searching for paths.
-typedef enum
-{
-    DEFAULT = 0, // Be wary of ghosts and energizers
-    IGNORE_GHOST = 1, // Consider ghosts not as obstacles
-    IGNORE_ENERGIZER = 2 // Consider energizers not as obstacles
-} search_settings;
+void search_arena_destroy(search_arena* a);
 
-/// High level functions for strategy making
+/**
+ * @brief An implementation fitted for the game of Dijkstra's algorithm, working in the search arena.
+ * @param g The graph representing the current game map
+ * @param a The search arena to hold the state of the search
+ * @param source The begin node to search from
+ * @param dest The end node in the adjacency, stops the algorithm when it is reached;
+ * -1 to let the algorithm reach every node
+ */
+void dijkstra(const graph g, search_arena* a, vec2 source, int dest);
 
 /**
- * @brief Create the AI engine, allocating the graph and storing round info.
- * @param map The game map
- * @param w The x position of pacman
- * @param y The y position of pacman
+ * @brief The number of steps between two positions if there were no walls, going across the
+ * borders of the map when it is shorter. No path between the two positions has fewer steps.
  * @param w The map width
  * @param h The map height
- * @return A newly allocated AI engine
+ * @param from A position
+ * @param to Another position
+ * @return The number of steps
  */
-ai_engine* ai_engine_create(char** map, int x, int y, int w, int h);
+int toroidal_distance(int w, int h, vec2 from, vec2 to);
 
 /**
- * @brief Initialise the AI engine, finding ghosts, virgin paths and energizers.
- * @param ai The engine to initialise
+ * @brief The A* algorithm, working in the search arena. Every position costs at least 1 to
+ * enter, so the toroidal distance to the target never overestimates the distance left.
+ * @param g The graph representing the current game map
+ * @param a The search arena to hold the state of the search
+ * @param source The begin node to search from
+ * @param target The end node, stops the algorithm when it is reached
  */
-void ai_engine_initialise(ai_engine* ai);
+void astar(const graph g, search_arena* a, vec2 source, vec2 target);
 
+#if SHORTEST_PATH_IMPL == SHORTEST_PATH_BIDIRECTIONAL
 /**
- * @brief Search the shortest paths between Pacman and the ghosts, trying to avoid energizers.
- * @param ai The engine to perform this action on
+ * @brief At least what going from a node to the target costs, once the backward search of
+ * bidirectional_dijkstra has stopped.
+ * @param g The graph representing the current game map
+ * @param a The search arena holding the backward search
+ * @param node The node
+ * @param target The end node of the backward search
+ * @param back_top The lowest distance left to settle backwards, -1 if none
+ * @return The lower bound, -1 if the node cannot reach the target
  */
-void ai_engine_search_ghosts(ai_engine* ai);
+int bidirectional_distance_left(const graph g, search_arena* a, int node, vec2 target, int back_top);
 
 /**
- * @brief Search the shortest paths between Pacman and the energizers, trying to avoid ghosts.
- * @param ai The engine to perform this action on
+ * @brief Search the shortest path between a source and a target from both ends at once.
+ * @param g The graph representing the current game map
+ * @param a The search arena to hold the state of both searches
+ * @param source The begin node to search from
+ * @param target The end node to search backwards from
+ * @return The node to go on the next move that shall lead to the shortest path, along with the weighted distance of the path.
  */
-void ai_engine_search_energizers(ai_engine* ai);
+path_result bidirectional_dijkstra(const graph g, search_arena* a, vec2 source, vec2 target);
+#endif
 
 /**
- * @brief Search the shortest paths between Pacman and the remaining Pacgums.
- * @param ai The engine to perform this action on
- * @param s A flag to tell the pathfinding algorithm to not avoid ghosts, or energizers
+ * @brief An implementation fitted for the game of Dijkstra's algorithm to find the shortest path between a source and a target.
+ * @param g The graph representing the current game map
+ * @param a The search arena to hold the state of the search
+ * @param source The begin node to search from
+ * @param target The end node, stops the algorithm when it is reached
+ * @return The node to go on the next move that shall lead to the shortest path, along with the weighted distance of the path.
  */
-void ai_engine_search_unexplored_paths(ai_engine* ai, search_settings s);
+path_result shortest_path(const graph g, search_arena* a, vec2 source, vec2 target);
 
 /**
- * @brief Set the AI engine decision to target the nearest ghost.
- * @param ai The engine to perform this action on
+ * @brief Run the Dijkstra's algorithm from the source without stopping at any target,
+ * so that the shortest path to every graph position is known in one pass. The paths
+ * are then read with `search_arena_get_path`, until the next search.
+ * @param g The graph representing the current game map
+ * @param a The search arena to hold the state of the search
+ * @param source The node to search from
  */
-void ai_engine_target_nearest_ghost(ai_engine* ai);
+void compute_distance_field(const graph g, search_arena* a, vec2 source);
 
 /**
- * @brief Set the AI engine decision to target the nearest energizer.
- * @param ai The engine to perform this action on
+ * @brief Prepare the bit-parallel breadth-first search over the positions of the adjacency.
+ * @param adj The adjacency of the positions Pacman can walk on
+ * @param w The map width
+ * @param h The map height
+ * @return The newly created flood fill
  */
-void ai_engine_target_nearest_energizer(ai_engine* ai);
+flood_fill* flood_fill_create(const adjacency* adj, int w, int h);
 
 /**
- * @brief Set the AI engine decision to target the nearest Pacgum.
- * @param ai The engine to perform this action on
+ * @brief Compute the distance from the source to every graph position, layer after layer,
+ * as the Dijkstra's algorithm would if every position cost 1 to enter. The weights of the
+ * graph are not read: it is up to the caller to make sure they are all 1. The paths are
+ * then read with `search_arena_get_path`, until the next search.
+ * @param g The graph representing the current game map
+ * @param a The search arena to hold the result of the search
+ * @param source The node to search from
  */
-void ai_engine_target_nearest_unexplored_path(ai_engine* ai);
+void flood_fill_search(const graph g, search_arena* a, vec2 source);
 
 /**
- * @brief Get the number of ghosts around Pacman.
- * @param ai The engine to perform this action on
- * @param max_distance The maximum distance to brand ghosts near at
- * @return The number of ghosts where their distance to Pacman is less than max_distance
+ * @brief Release the memory held by the flood fill.
+ * @param f The flood fill to destroy
  */
-int ai_engine_get_number_ghosts_near(const ai_engine* ai, int max_distance);
+void flood_fill_destroy(flood_fill* f);
 
 /**
- * @brief Get the number of energizers that are yet to be eaten.
- * @param ai The engine to perform this action on
- * @return The number of energizers left
+ * @brief A convenience function to delete the graph when it is no longer needed.
+ * @param g The graph to dispose of
  */
-int ai_engine_get_number_energizers_left(const ai_engine* ai);
+void dispose_graph(graph g);
 
 /**
- * @brief Get the number of Pacgums that are yet to be eaten.
- * @param ai The engine to perform this action on
- * @return The number of Pacgums left
+ * @brief The weight comparator used by the priority queue in Dijkstra's algorithm.
+ * @param left A value
+ * @param right A value
+ * @return < 0 if left < right, 0 if left == right, > 0 if left > right
  */
-int ai_engine_get_number_virgin_paths_left(const ai_engine* ai);
+int compare_weights(value left, value right);
+
+#if PATHFINDING_IMPL == PATHFINDING_JUNCTION_GRAPH
 
 /**
- * @brief Compute the final decision of the AI engine.
- * @param ai The engine to perform this action on
- * @return The next move of Pacman, ready to be passed to the game engine
+ * @brief Contract the corridors of the adjacency to build its junction graph.
+ * @param adj The adjacency of the positions Pacman can walk on
+ * @return The newly created junction graph
  */
-direction ai_engine_get_next_move(const ai_engine* ai);
+junction_graph* create_junction_graph(const adjacency* adj);
 
 /**
- * @brief Clean up any resources taken by the AI engine (dynamic allocs).
- * @param ai The engine to destroy
+ * @brief Forget the counts and the sums of every corridor, when the whole graph is built
+ * again. Each corridor is counted again the first time a search walks along it.
+ * @param j The junction graph
  */
-void ai_engine_destroy(ai_engine* ai);
+void junction_graph_reset(junction_graph* j);
 
-/// Low level functions
+/**
+ * @brief Count the new entity of a node in its corridor, if it is inside one, and forget
+ * the sums of the corridors whose weights it changes.
+ * @param j The junction graph
+ * @param node The node whose entity, or the weight of it, changed
+ * @param entity The character now on the map at this node
+ */
+void junction_graph_update(junction_graph* j, int node, char entity);
 
 /**
- * @brief A convenience function to get the index of the shortest path.
- * @param paths The paths to analyse
- * @param path_count The number of paths to analyse
- * @return The index of the shortest path.
+ * @brief Get the node at the given position of a corridor.
+ * @param j The junction graph
+ * @param c The corridor
+ * @param pos The position in the corridor, from 0 to its length
+ * @return The node at this position
  */
-int get_nearest_entity_index(const path_result* paths, int path_count);
+int corridor_node(const junction_graph* j, const corridor* c, int pos);
 
 /**
- * @brief Compute the shortest path for each entity provided at the given positions.
- * The results array must be allocated and of size position_count.
- * @param g The graph to use to execute the pathfinding algorithm
- * @param pacman The x-y position of Pacman
- * @param positions The entities to be taken as targets by the pathfinding algorithm
- * @param position_count The number of entities
- * @param results The path results produced by the pathfinding algorithm
+ * @brief Get the weighted cost of walking along a corridor, using the weights of the graph.
+ * The sums of the weights along the corridor are made if it has none.
+ * @param g The graph representing the current game map
+ * @param j The junction graph
+ * @param c The corridor
+ * @param from The position to start from
+ * @param to The position to stop at, either before or after `from`
+ * @return The sum of the weights of the positions entered, -1 if one of them cannot be crossed
  */
-void compute_shortest_paths(graph g, vec2 pacman, const vec2* positions, int position_count, path_result* results);
+int corridor_cost(const graph g, junction_graph* j, corridor* c, int from, int to);
 
 /**
- * @brief Calculate the direction to go from a given x-y target.
- * The target must exactly be at a distance of one from Pacman.
- * @param pacman The position of Pacman
- * @param target The position to go on the next round
- * @param w The game width, to handle map borders
- * @param h The game height, to handle map borders
+ * @brief Run the Dijkstra's algorithm over the junctions, from the source to every junction.
+ * The paths are then read with `junction_graph_get_path`, until the next search.
+ * @param g The graph representing the current game map
+ * @param a The search arena to hold the state of the search, with one record per junction
+ * @param source The node to search from
  */
-direction orientation(vec2 pacman, vec2 target, int w, int h);
+void junction_graph_search(const graph g, search_arena* a, vec2 source);
 
-// ***********************************************************************************
-// **************************** END OF PROTOTYPES SECTION ****************************
-// ***********************************************************************************
+/**
+ * @brief Read the shortest path to the given target from the last search over the junctions.
+ * @param g The graph the last search ran on
+ * @param a The search arena used by the last search
+ * @param target The end node of the path
+ * @return The node to go on the next move, the weighted distance and the raw size of the path
+ */
+path_result junction_graph_get_path(const graph g, search_arena* a, vec2 target);
 
-// change the pacman function below to build your own player
-// your new pacman function can use as many additional functions/procedures as needed; put the code of these functions/procedures *AFTER* the pacman function
-direction pacman(
-		 char * * map, // the map as a dynamic array of strings, ie of arrays of chars
-		 int xsize, // number of columns of the map
-		 int ysize, // number of lines of the map
-		 int x, // x-position of pacman in the map 
-		 int y, // y-position of pacman in the map
-		 direction lastdirection, // last move made by pacman (see pacman.h for the direction type; lastdirection value is -1 at the beginning of the game
-		 bool energy, // is pacman in energy mode? 
-		 int remainingenergymoderounds // number of remaining rounds in energy mode, if energy mode is true
-		 ) {
-    direction d;
-    
-    const int ghost_chasing_threshold = 65; // Below this threshold, Pacman shall stop chasing ghosts
-    const int ghost_proximity_threshold = 1; // If there are more than this value of ghosts around Pacman, it shall seek an energizer, if any
-    
-    // Create and initialise the AI engine from the game map
-    ai_engine* ai = ai_engine_create(map, x, y, xsize, ysize);
-    ai_engine_initialise(ai);
-    
-    // Search for ghosts before making any kind of decision
-    ai_engine_search_ghosts(ai);
-    
-    if (energy && remainingenergymoderounds > ghost_chasing_threshold) // If we have enough time in powered-up mode...
-    {
-        // Pursue those evil ghosts.
-        ai_engine_target_nearest_ghost(ai);
-    }
-    // If we are pursued by at least one ghost, and there are energizers out there, or there are only energizers left...
-    else if ((!energy && ai_engine_get_number_ghosts_near(ai, 5) >= ghost_proximity_threshold && ai_engine_get_number_energizers_left(ai) > 0)
-        || (ai_engine_get_number_energizers_left(ai) > 0 && ai_engine_get_number_virgin_paths_left(ai) == 0))
-    {
-        // Get them energizers.
-        ai_engine_search_energizers(ai);
-        ai_engine_target_nearest_energizer(ai);
-    }
-    else
-    {
-        // By default, Pacman shall avoid eating energizers needlessly, and will avoid ghosts
-        search_settings s = DEFAULT;
-        
-        if (energy) // If Pacman is powered up, then treat ghosts as simple snacks
-            s |= IGNORE_GHOST;
-        
-        // Go get all those Pacgums
-        ai_engine_search_unexplored_paths(ai, s);
-        ai_engine_target_nearest_unexplored_path(ai);
-    }
-    
-    // Ask the game engine for the next move
-    d = ai_engine_get_next_move(ai);
-    
-    // Cleanup the AI engine, we are not allowed to keep any kind of state across calls of the pacman function
-    ai_engine_destroy(ai);
-    
-    // Anwser the game engine
-    return d;
-}
+/**
+ * @brief Release the memory held by the junction graph.
+ * @param j The junction graph to dispose of
+ */
+void dispose_junction_graph(junction_graph* j);
 
+#elif PATHFINDING_IMPL == PATHFINDING_DISTANCE_TABLE
 
-// the code of your additional functions/procedures must be put below
+/**
+ * @brief Get the distance table of the level, filling it if the walls are not the ones
+ * of the level it was last filled for. The table of the previous level is released.
+ * @param adj The adjacency of the positions Pacman can walk on
+ * @param w The map width
+ * @param h The map height
+ * @return The distance table of the level, NULL if the level has too many positions
+ */
+const distance_table* distance_table_acquire(const adjacency* adj, int w, int h);
 
-// **********************************************************************************
-// Linked list functions implementation
-// **********************************************************************************
+/**
+ * @brief Get the number of steps between two nodes, regardless of the entities on the way.
+ * @param t The distance table
+ * @param from The node to start from
+ * @param to The node to go to
+ * @return The number of steps, -1 if there is no path
+ */
+int distance_table_get(const distance_table* t, int from, int to);
 
-list* list_new()
-{
-    list* l = malloc(sizeof(list));
-    l->first = NULL;
-    l->size = 0;
-    
-    return l;
-}
+/**
+ * @brief Get the shortest weighted path between two nodes from the distance table. The
+ * distance is only searched for if a position whose weight is not 1 lies on a path of
+ * the table, in which case the search is bounded.
+ * @param g The graph representing the current game map
+ * @param a The search arena to hold the state of the search
+ * @param source The begin node
+ * @param target The end node
+ * @param penalties The nodes, other than the source, whose weight is not 1
+ * @param penalty_count The number of such nodes
+ * @param res The path found
+ * @return true if the path is known, false if the search gave up
+ */
+bool distance_table_get_path(const graph g, search_arena* a, int source, vec2 target, const int* penalties, int penalty_count, path_result* res);
 
-void list_delete(list* l)
-{
-    node* current = l->first;
-    
-    // To free a linked list properly, one must iterate
-    // through all its elements and free them one by one.
-    while (current)
-    {
-        node* next = current->next;
-        free(current);
-        
-        current = next;
-    }
-    
-    free(l);
-}
+#endif
 
-int list_size(list* l)
-{
-    return l->size;
-}
+// ***********************************************************************************
+// Change tracking structures & functions declaration
+// ***********************************************************************************
 
-int list_append(list* l, value v)
+// A type to remember what the graph was last built from, so that it can be brought up
+// to date by recomputing only the positions that changed since. The positions found to
+// have changed are pending until the next synchronisation applies them, so that other
+// parts of the AI can follow the same changes in the meantime.
+typedef struct
 {
-    // Appending an element is equivalent to
-    // insert it to the end of the list.
-    
-    list_iterator it = list_iterator_begin(l);
+    char* snapshot; // A copy of the map the graph was last built from, row after row
+    entities_weights weights; // The weights the graph was last built with
+    bool valid; // False until the graph has been built once
     
-    while (!list_iterator_end(it))
-    {
-        it = list_iterator_next(it);
-    }
+    int* changes; // The graph positions that changed since the last synchronisation
+    int change_count;
+    bool* changed; // changed[k] is true if k is already in the changes
     
-    // Here, it points to the latest element, which is NULL
-    
-    return list_insert(it, v);
-}
+    int w;
+    int h;
+} map_tracker;
 
-int list_remove(list* l, int idx)
-{
-    // Don't try to remove an element out of the list.
-    if (idx >= l->size)
-        return 0;
+/**
+ * @brief Create a change tracker for a map of the given dimensions. The first
+ * synchronisation will build the whole graph.
+ * @param w The map width
+ * @param h The map height
+ * @return The newly created tracker
+ */
+map_tracker* map_tracker_create(int w, int h);
 
-    int i;
-    
-    node* n = l->first;
-    
-    // Deleting the first element needs special attention: 
-    // we can't iterate until its predecessor, since it does 
-    // not have any.
-    if (idx == 0)
-    {
-        l->first = n->next;
-        free(n);
-    }
-    else
-    {
-        // Iterate until the predecessor...
-        for (i = 0; i < idx - 1; i++)
-        {
-            n = n->next;
-        }
-        
-        // ...and swap the places before freeing the
-        // element to delete.
-        node* rip = n->next;
-        n->next = rip->next;
-        
-        free(rip);
-    }
-    
-    // Don't forget to decrease the list size.
-    l->size--;
-    
-    return 1;
-}
+/**
+ * @brief Bring the graph up to date with its map and the given weights, recomputing only
+ * the weights leading to positions whose entity changed, or whose entity weight changed,
+ * since the last synchronisation. The positions whose entity changed are the ones
+ * recorded by `map_tracker_diff` since then.
+ * @param t The tracker of the graph
+ * @param g The graph to update
+ * @param weights The weights to apply
+ */
+void map_tracker_sync(map_tracker* t, graph g, entities_weights weights);
 
-list_iterator list_iterator_begin(list* l)
-{
-    // Return an iterator object pointing to the first element
-    // of the list.
-    list_iterator beg = {l, &l->first};
-    return beg;
-}
+/**
+ * @brief Record a graph position as changed, to be applied by the next synchronisation.
+ * @param t The tracker
+ * @param idx The graph position that changed
+ */
+void map_tracker_mark(map_tracker* t, int idx);
 
-int list_iterator_end(list_iterator it)
-{
-    // Signal if the iterator has reached the end of the list.
-    return *it.ptr == NULL;
-}
+/**
+ * @brief Compare the map against the snapshot, row by row, recording the positions
+ * that differ and updating the snapshot accordingly.
+ * @param t The tracker
+ * @param map The current game map
+ */
+void map_tracker_diff(map_tracker* t, char** map);
 
-list_iterator list_iterator_next(list_iterator it)
-{
-    // Return a iterator pointing to the element following
-    // the one pointed by this iterator.
-    list_iterator next = {it.l, &(*it.ptr)->next};
-    return next;
-}
+/**
+ * @brief Tell whether the walls or the Door moved among the pending changes, meaning that
+ * the map is not the one the graph was created for.
+ * @param t The tracker
+ * @param g The graph of the tracker
+ * @return True if a position changed between Pacman being able to walk on it or not
+ */
+bool map_tracker_walls_changed(const map_tracker* t, const graph g);
 
-int list_insert(list_iterator it, value v)
+/**
+ * @brief Release the memory held by the tracker.
+ * @param t The tracker to destroy
+ */
+void map_tracker_destroy(map_tracker* t);
+
+// ***********************************************************************************
+// Entity finder structures & functions
+// ***********************************************************************************
+
+// A simple type to represent our findings in the map.
+typedef struct
 {
-    // Insert a list node before the node pointed by
-    // the iterator.
-    
-    node* n = malloc(sizeof(node));
-    if (!n) // Node allocation failure, exit early
-        return 0;
-    
-    n->v = v; // Fill the actual value
+    vec2* positions;
+    int count;
+} findings;
+
+/**
+ * @brief Convenience function to free the allocated resources created by the findings.
+ * @param f The findings to free
+ */
+void dispose_findings(findings f);
+
+// ***********************************************************************************
+// Bitboard structures & functions declaration
+// ***********************************************************************************
+
+// The classes of entities a bitboard keeps track of.
+typedef enum
+{
+    BOARD_WALL = 0,
+    BOARD_PELLET = 1,
+    BOARD_ENERGIZER = 2,
+    BOARD_GHOST = 3,
+    BOARD_DOOR = 4
+} board_class;
+
+#define BOARD_CLASS_COUNT 5
+
+// The map seen as one set of positions per class of entities, one bit per position:
+// each row is a run of 64-bit words, and bit x % 64 of word x / 64 stands for column x.
+// Telling whether an entity stands somewhere is then a matter of testing a bit, and the
+// entities of each class are counted as the bits are set and cleared.
+typedef struct
+{
+    unsigned long long* bits; // The rows of every class, one class after the other
+    int counts[BOARD_CLASS_COUNT]; // The bits set in the rows of each class
+    unsigned char classes[256]; // classes[c] = the class of character c, BOARD_CLASS_COUNT if none
+    int* column_starts; // Where each column starts when listing positions column by column
+    int words; // The number of words in a row
+    int w;
+    int h;
+} bitboard;
+
+/**
+ * @brief Count the bits set in a word.
+ * @param word The word
+ * @return The number of bits set
+ */
+int bitboard_popcount(unsigned long long word);
+
+/**
+ * @brief Get the position of the lowest bit set in a word.
+ * @param word The word, which must not be zero
+ * @return The position of the lowest bit set, 0 being the least significant one
+ */
+int bitboard_lowest_bit(unsigned long long word);
+
+/**
+ * @brief Allocate a bitboard matching the dimensions of the map.
+ * @param w The map width
+ * @param h The map height
+ * @return The newly created bitboard, empty
+ */
+bitboard* bitboard_create(int w, int h);
+
+/**
+ * @brief Fill the bitboard from the game map, classifying each of its positions in a
+ * single pass, row after row.
+ * @param b The bitboard to fill
+ * @param map The game map
+ */
+void bitboard_build(bitboard* b, char** map);
+
+/**
+ * @brief Reclassify a single position of the bitboard after its character changed. A
+ * ghost coming over a Pacgum or an energizer does not hide it: the bitboard keeps
+ * remembering it until something else than a ghost is seen there.
+ * @param b The bitboard to update
+ * @param idx The graph position that changed
+ * @param c The character now on the map at this position
+ */
+void bitboard_update(bitboard* b, int idx, char c);
+
+/**
+ * @brief Get a row of the positions of a class.
+ * @param b The bitboard
+ * @param c The class
+ * @param y The row
+ * @return The words of the row
+ */
+const unsigned long long* bitboard_row(const bitboard* b, board_class c, int y);
+
+/**
+ * @brief Tell whether an entity of the given class stands at the specified position.
+ * @param b The bitboard
+ * @param c The class
+ * @param pos The x-y position, which must be on the map
+ * @return True if an entity of this class is there
+ */
+bool bitboard_test(const bitboard* b, board_class c, vec2 pos);
+
+/**
+ * @brief Count the entities of the given class on the whole map, without going through it.
+ * @param b The bitboard
+ * @param c The class
+ * @return The number of entities of this class
+ */
+int bitboard_count(const bitboard* b, board_class c);
+
+/**
+ * @brief Tell which neighbors of the specified position hold an entity of the given class.
+ * Supports mirroring of the map.
+ * @param b The bitboard
+ * @param c The class
+ * @param pos The x-y position, which must be on the map
+ * @return A mask with bit dir set if the neighbor in direction dir holds such an entity
+ */
+unsigned char bitboard_neighbors(const bitboard* b, board_class c, vec2 pos);
+
+/**
+ * @brief List the positions of the entities of the given class, column after column
+ * and from top to bottom in each column.
+ * @param b The bitboard
+ * @param c The class
+ * @param out A findings structure passed by address to store the positions
+ */
+void bitboard_extract(bitboard* b, board_class c, findings* out);
+
+/**
+ * @brief Release the memory held by the bitboard.
+ * @param b The bitboard to destroy
+ */
+void bitboard_destroy(bitboard* b);
+
+// ***********************************************************************************
+// Threat field structures & functions declaration
+// ***********************************************************************************
+
+// By default, a ghost this many steps away from a position, or fewer, is near it.
+#define THREAT_NEAR_RADIUS 4
+
+// How soon the ghosts can reach each position of the map, computed by a single breadth-first
+// search started from all the ghosts at once. Unlike Pacman, the ghosts can go through the Door.
+// The search stops at a horizon, so that its work does not depend on the size of the map.
+typedef struct
+{
+    int* time; // time[k] = steps for the first ghost to reach graph position k, -1 if none can within the horizon
+    int* nearest; // nearest[k] = the ghost reaching graph position k first, if any can
+    int* sources; // The graph positions of the ghosts, where the search started from
+    int source_count;
+    int* queue; // The queue of the breadth-first searches
+    unsigned int* seen; // seen[k] = the stamp of the last count to reach graph position k
+    unsigned int stamp;
+    int w;
+    int h;
+} threat_field;
+
+/**
+ * @brief Allocate a threat field matching the dimensions of the map.
+ * @param w The map width
+ * @param h The map height
+ * @return The newly created threat field
+ */
+threat_field* threat_field_create(int w, int h);
+
+/**
+ * @brief Compute how soon the ghosts can reach each position of the map.
+ * @param t The threat field to fill
+ * @param map The game map
+ * @param ghosts The positions of the ghosts, out of the map for the ghosts that could not be found
+ * @param ghost_count The number of ghosts
+ * @param horizon The number of steps beyond which the positions are left unreached
+ */
+void threat_field_compute(threat_field* t, char** map, const vec2* ghosts, int ghost_count, int horizon);
+
+/**
+ * @brief Get the number of steps for the first ghost to reach a position.
+ * @param t The threat field
+ * @param pos The x-y position
+ * @return The number of steps, -1 if no ghost can reach the position within the horizon
+ */
+int threat_field_time(const threat_field* t, vec2 pos);
+
+/**
+ * @brief Get the ghost reaching a position first.
+ * @param t The threat field
+ * @param pos The x-y position
+ * @return The index of the ghost, -1 if no ghost can reach the position within the horizon
+ */
+int threat_field_nearest(const threat_field* t, vec2 pos);
+
+/**
+ * @brief Get the number of ghosts near a position, as of the last computation.
+ * @param t The threat field
+ * @param map The game map
+ * @param pos The x-y position
+ * @param radius The number of steps up to which a ghost is near a position, at most the horizon
+ * @return The number of ghosts near the position
+ */
+int threat_field_count_near(threat_field* t, char** map, vec2 pos, int radius);
+
+/**
+ * @brief Release the memory held by the threat field.
+ * @param t The threat field to destroy
+ */
+void threat_field_destroy(threat_field* t);
+
+// ***********************************************************************************
+// Strategy structures & functions declarations
+// ***********************************************************************************
+
+// The constants the strategy is built upon. They are read at every call of the pacman
+// function, and can be changed between two calls to tune how Pacman behaves.
+typedef struct
+{
+    int ghost_chasing_threshold; // Below this many rounds of energy mode left, Pacman stops chasing ghosts
+    int ghost_proximity_threshold; // From this many ghosts near Pacman, it seeks an energizer, if any
+    int ghost_near_radius; // A ghost this many steps away from Pacman, or fewer, is near it
+    unsigned char chase_energizer_weight; // The weight of the energizers while chasing ghosts
+    unsigned char flee_ghost_weight; // The weight of the ghosts while seeking energizers
+    unsigned char pellet_energizer_weight; // The weight of the energizers while seeking Pacgums
+    unsigned char pellet_ghost_weight; // The weight of the ghosts while seeking Pacgums
+} strategy_parameters;
+
+// The parameters of the strategy, global as the pacman function cannot be given any.
+strategy_parameters strategy = {
+    .ghost_chasing_threshold = 65,
+    .ghost_proximity_threshold = 1,
+    .ghost_near_radius = THREAT_NEAR_RADIUS,
+    .chase_energizer_weight = 50,
+    .flee_ghost_weight = 50,
+    .pellet_energizer_weight = 20,
+    .pellet_ghost_weight = 50
+};
+
+// A new type to handle the whole context of the AI.
+typedef struct
+{
+    graph g;
+    map_tracker* tracker;
+    search_arena* arena;
+    threat_field* threats;
+    bitboard* board;
+    vec2 pacman;
+    entities_weights weights;
     
-    // Swap the places with current node.
-    n->next = *it.ptr;
-    *it.ptr = n;
+    findings ghosts;
+    findings energizers;
+    findings virgin_paths;
     
-    // Don't forget to increase the list size.
-    it.l->size++;
+    path_result* paths_to_ghosts;
+    path_result* paths_to_energizers;
+    path_result* paths_to_virgin_paths;
     
-    return 1;
+    direction decision;
+} ai_engine;
+
+// A struct to tweak how pacman behaves when searching for paths.
+typedef enum
+{
+    DEFAULT = 0, // Be wary of ghosts and energizers
+    IGNORE_GHOST = 1, // Consider ghosts not as obstacles
+    IGNORE_ENERGIZER = 2 // Consider energizers not as obstacles
+} search_settings;
+
+/// High level functions for strategy making
+
+/**
+ * @brief Create the AI engine, allocating the graph and storing round info.
+ * @param map The game map
+ * @param w The x position of pacman
+ * @param y The y position of pacman
+ * @param w The map width
+ * @param h The map height
+ * @return A newly allocated AI engine
+ */
+ai_engine* ai_engine_create(char** map, int x, int y, int w, int h);
+
+/**
+ * @brief Get the AI engine kept from the previous call of the pacman function, brought up
+ * to date with the positions of the map that changed since. A new engine is created on the
+ * first move of a game, or if the walls are not the ones the engine was created for.
+ * @param map The game map
+ * @param x The x position of pacman
+ * @param y The y position of pacman
+ * @param w The map width
+ * @param h The map height
+ * @param lastdirection The last move made by Pacman, -1 at the beginning of the game
+ * @return The AI engine, to be initialised like a new one
+ */
+ai_engine* ai_engine_acquire(char** map, int x, int y, int w, int h, direction lastdirection);
+
+/**
+ * @brief Initialise the AI engine, finding ghosts and classifying the map in a bitboard.
+ * The bitboard of an engine kept from the previous move is only updated where the map changed.
+ * @param ai The engine to initialise
+ */
+void ai_engine_initialise(ai_engine* ai);
+
+/**
+ * @brief Search the shortest paths between Pacman and the ghosts, trying to avoid energizers.
+ * @param ai The engine to perform this action on
+ */
+void ai_engine_search_ghosts(ai_engine* ai);
+
+/**
+ * @brief Search the shortest paths between Pacman and the energizers, trying to avoid ghosts.
+ * @param ai The engine to perform this action on
+ */
+void ai_engine_search_energizers(ai_engine* ai);
+
+/**
+ * @brief Search the shortest paths between Pacman and the remaining Pacgums.
+ * @param ai The engine to perform this action on
+ * @param s A flag to tell the pathfinding algorithm to not avoid ghosts, or energizers
+ */
+void ai_engine_search_unexplored_paths(ai_engine* ai, search_settings s);
+
+/**
+ * @brief Bring the graph up to date with the weights of the engine. The ghosts are the
+ * positions the threat field was started from, and the energizers are in the bitboard:
+ * when only their weights change, the map is not looked through to find them.
+ * @param ai The engine to perform this action on
+ */
+void ai_engine_update_graph(ai_engine* ai);
+
+/**
+ * @brief Set the AI engine decision to target the nearest ghost.
+ * @param ai The engine to perform this action on
+ */
+void ai_engine_target_nearest_ghost(ai_engine* ai);
+
+/**
+ * @brief Set the AI engine decision to target the nearest energizer.
+ * @param ai The engine to perform this action on
+ */
+void ai_engine_target_nearest_energizer(ai_engine* ai);
+
+/**
+ * @brief Set the AI engine decision to target the nearest Pacgum.
+ * @param ai The engine to perform this action on
+ */
+void ai_engine_target_nearest_unexplored_path(ai_engine* ai);
+
+/**
+ * @brief Get the number of ghosts around Pacman, read from the threat field.
+ * @param ai The engine to perform this action on
+ * @return The number of ghosts at most strategy.ghost_near_radius steps away from Pacman
+ */
+int ai_engine_get_number_ghosts_near(const ai_engine* ai);
+
+/**
+ * @brief Get the number of energizers that are yet to be eaten.
+ * @param ai The engine to perform this action on
+ * @return The number of energizers left
+ */
+int ai_engine_get_number_energizers_left(const ai_engine* ai);
+
+/**
+ * @brief Get the number of Pacgums that are yet to be eaten.
+ * @param ai The engine to perform this action on
+ * @return The number of Pacgums left
+ */
+int ai_engine_get_number_virgin_paths_left(const ai_engine* ai);
+
+/**
+ * @brief Tell whether every position Pacman can walk on costs 1 to enter with the current
+ * weights, given the entities on the map.
+ * @param ai The engine to perform this action on
+ * @return True if the shortest paths are those of a breadth-first search
+ */
+bool ai_engine_has_unit_weights(const ai_engine* ai);
+
+/**
+ * @brief Compute the shortest path from Pacman to each of the given positions, with the
+ * bit-parallel breadth-first search when the weights allow it.
+ * The results array must be allocated and of size position_count.
+ * @param ai The engine to perform this action on
+ * @param positions The entities to be taken as targets by the pathfinding algorithm
+ * @param position_count The number of entities
+ * @param results The path results produced by the pathfinding algorithm
+ */
+void ai_engine_compute_paths(ai_engine* ai, const vec2* positions, int position_count, path_result* results);
+
+/**
+ * @brief Compute the final decision of the AI engine.
+ * @param ai The engine to perform this action on
+ * @return The next move of Pacman, ready to be passed to the game engine
+ */
+direction ai_engine_get_next_move(const ai_engine* ai);
+
+/**
+ * @brief Release the entities and paths found during a move, keeping the rest of the
+ * engine for the next one.
+ * @param ai The engine whose move is over
+ */
+void ai_engine_end_turn(ai_engine* ai);
+
+/**
+ * @brief Clean up any resources taken by the AI engine (dynamic allocs).
+ * @param ai The engine to destroy
+ */
+void ai_engine_destroy(ai_engine* ai);
+
+/// Low level functions
+
+/**
+ * @brief A convenience function to get the index of the shortest path.
+ * @param paths The paths to analyse
+ * @param path_count The number of paths to analyse
+ * @return The index of the shortest path.
+ */
+int get_nearest_entity_index(const path_result* paths, int path_count);
+
+/**
+ * @brief Compute the shortest path for each entity provided at the given positions.
+ * A single distance field is computed from Pacman, then every target is a lookup.
+ * The results array must be allocated and of size position_count.
+ * @param g The graph to use to execute the pathfinding algorithm
+ * @param a The search arena to hold the state of the search
+ * @param pacman The x-y position of Pacman
+ * @param positions The entities to be taken as targets by the pathfinding algorithm
+ * @param position_count The number of entities
+ * @param results The path results produced by the pathfinding algorithm
+ */
+void compute_shortest_paths(graph g, search_arena* a, vec2 pacman, const vec2* positions, int position_count, path_result* results);
+
+/**
+ * @brief Calculate the direction to go from a given x-y target.
+ * The target must exactly be at a distance of one from Pacman.
+ * @param g The graph, whose adjacency handles map borders
+ * @param pacman The position of Pacman
+ * @param target The position to go on the next round
+ * @return The direction leading to the target, -1 if it is not a neighbor of Pacman
+ */
+direction orientation(const graph g, vec2 pacman, vec2 target);
+
+/**
+ * @brief Choose a move by looking at the neighbors of Pacman only, for the maps the AI
+ * is not built for: a neighbor with a Pacgum or an energizer first, then any free one,
+ * going on in the last direction when it can.
+ * @param map The game map
+ * @param w The map width
+ * @param h The map height
+ * @param x The x position of pacman
+ * @param y The y position of pacman
+ * @param lastdirection The last move made by Pacman, -1 at the beginning of the game
+ * @return The direction to go, the last direction if every neighbor is blocked
+ */
+direction fallback_move(char** map, int w, int h, int x, int y, direction lastdirection);
+
+// ***********************************************************************************
+// **************************** END OF PROTOTYPES SECTION ****************************
+// ***********************************************************************************
+
+// change the pacman function below to build your own player
+// your new pacman function can use as many additional functions/procedures as needed; put the code of these functions/procedures *AFTER* the pacman function
+direction pacman(
+		 char * * map, // the map as a dynamic array of strings, ie of arrays of chars
+		 int xsize, // number of columns of the map
+		 int ysize, // number of lines of the map
+		 int x, // x-position of pacman in the map 
+		 int y, // y-position of pacman in the map
+		 direction lastdirection, // last move made by pacman (see pacman.h for the direction type; lastdirection value is -1 at the beginning of the game
+		 bool energy, // is pacman in energy mode? 
+		 int remainingenergymoderounds // number of remaining rounds in energy mode, if energy mode is true
+		 ) {
+    direction d;
+    
+#ifdef ALLOCATION_STATS
+    allocation_counters before = allocations; // To count the allocations made by this call
+#endif
+    
+#ifdef DECISION_STATS
+    // The instrumentation tells about this call only
+    memset(&decision_last, 0, sizeof(decision_last));
+    decision_last.decisions = 1;
+#endif
+    
+    const int ghost_chasing_threshold = strategy.ghost_chasing_threshold; // Below this threshold, Pacman shall stop chasing ghosts
+    const int ghost_proximity_threshold = strategy.ghost_proximity_threshold; // If there are more than this value of ghosts around Pacman, it shall seek an energizer, if any
+    
+    // The types of the AI are sized at compile time for a maximal map size: on a larger
+    // map, Pacman only looks around itself, and the game goes on.
+    if ((long)xsize * ysize > MAP_MAX_CELLS || xsize > MAP_MAX_SIDE || ysize > MAP_MAX_SIDE)
+    {
+        static bool warned = false;
+        
+        if (!warned)
+            fprintf(stderr, "pacman: a %dx%d map is larger than MAP_MAX_CELLS or MAP_MAX_SIDE, see README.md\n", xsize, ysize);
+        
+        warned = true;
+        
+        return fallback_move(map, xsize, ysize, x, y, lastdirection);
+    }
+    
+    DECISION_PHASE_BEGIN(PHASE_CREATE);
+#ifdef PERSISTENT_ENGINE
+    // Reuse the AI engine of the previous move, updated from what changed on the map
+    ai_engine* ai = ai_engine_acquire(map, x, y, xsize, ysize, lastdirection);
+#else
+    // Create and initialise the AI engine from the game map
+    ai_engine* ai = ai_engine_create(map, x, y, xsize, ysize);
+#endif
+    DECISION_PHASE_END(PHASE_CREATE);
+    
+    DECISION_PHASE_BEGIN(PHASE_INITIALISE);
+    ai_engine_initialise(ai);
+    DECISION_PHASE_END(PHASE_INITIALISE);
+    
+    if (energy && remainingenergymoderounds > ghost_chasing_threshold) // If we have enough time in powered-up mode...
+    {
+        // Pursue those evil ghosts.
+        ai_engine_search_ghosts(ai);
+        ai_engine_target_nearest_ghost(ai);
+    }
+    // If we are pursued by at least one ghost, and there are energizers out there, or there are only energizers left...
+    else if ((!energy && ai_engine_get_number_ghosts_near(ai) >= ghost_proximity_threshold && ai_engine_get_number_energizers_left(ai) > 0)
+        || (ai_engine_get_number_energizers_left(ai) > 0 && ai_engine_get_number_virgin_paths_left(ai) == 0))
+    {
+        // Get them energizers.
+        ai_engine_search_energizers(ai);
+        ai_engine_target_nearest_energizer(ai);
+    }
+    else
+    {
+        // By default, Pacman shall avoid eating energizers needlessly, and will avoid ghosts
+        search_settings s = DEFAULT;
+        
+        if (energy) // If Pacman is powered up, then treat ghosts as simple snacks
+            s |= IGNORE_GHOST;
+        
+        // Go get all those Pacgums
+        ai_engine_search_unexplored_paths(ai, s);
+        ai_engine_target_nearest_unexplored_path(ai);
+    }
+    
+    // Ask the game engine for the next move
+    DECISION_PHASE_BEGIN(PHASE_NEXT_MOVE);
+    d = ai_engine_get_next_move(ai);
+    DECISION_PHASE_END(PHASE_NEXT_MOVE);
+    
+#ifdef PERSISTENT_ENGINE
+    // Only forget what was found during this move, the engine is kept for the next one
+    ai_engine_end_turn(ai);
+#else
+    // Cleanup the AI engine, we are not allowed to keep any kind of state across calls of the pacman function
+    ai_engine_destroy(ai);
+#endif
+    
+#ifdef ALLOCATION_STATS
+    allocation_last.mallocs = allocations.mallocs - before.mallocs;
+    allocation_last.reallocs = allocations.reallocs - before.reallocs;
+    allocation_last.frees = allocations.frees - before.frees;
+
+    allocation_totals.mallocs += allocation_last.mallocs;
+    allocation_totals.reallocs += allocation_last.reallocs;
+    allocation_totals.frees += allocation_last.frees;
+#endif
+    
+#ifdef DECISION_STATS
+    decision_stats_add(&decision_totals, &decision_last);
+#endif
+    
+    // Anwser the game engine
+    return d;
+}
+
+
+// the code of your additional functions/procedures must be put below
+
+// **********************************************************************************
+// Memory management functions implementation
+// **********************************************************************************
+
+void* tracked_malloc(size_t size)
+{
+    allocations.mallocs++;
+    return malloc(size);
+}
+
+void* tracked_realloc(void* ptr, size_t size)
+{
+    allocations.reallocs++;
+    return realloc(ptr, size);
+}
+
+void tracked_free(void* ptr)
+{
+    // Freeing NULL does not reach the allocator.
+    if (ptr)
+        allocations.frees++;
+
+    free(ptr);
+}
+
+// **********************************************************************************
+// Instrumentation functions implementation
+// **********************************************************************************
+
+#ifdef DECISION_STATS
+
+// The values read when a phase started.
+typedef struct
+{
+    unsigned long long ns;
+    unsigned long long counters[3]; // Cycles, instructions, cache misses
+} phase_start;
+
+static phase_start phase_starts[PHASE_COUNT];
+
+// The hardware counters are opened as a group on the first phase: -1 if they could not be.
+static int perf_group = -2;
+
+#ifdef __linux__
+static int perf_open(unsigned long long config, int group)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = group == -1; // The group starts when its leader is enabled
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+#endif
+
+static void perf_setup(void)
+{
+    perf_group = -1;
+
+#ifdef __linux__
+    // Without the permission (see perf_event_paranoid) or the hardware, only the wall
+    // time is recorded.
+    int leader = perf_open(PERF_COUNT_HW_CPU_CYCLES, -1);
+
+    if (leader == -1)
+        return;
+
+    if (perf_open(PERF_COUNT_HW_INSTRUCTIONS, leader) == -1 || perf_open(PERF_COUNT_HW_CACHE_MISSES, leader) == -1)
+    {
+        close(leader);
+        return;
+    }
+
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    perf_group = leader;
+#endif
+}
+
+static bool perf_read(unsigned long long* counters)
+{
+    // A group is read as its number of counters, followed by their values.
+    unsigned long long values[4];
+
+    if (perf_group < 0 || read(perf_group, values, sizeof(values)) != sizeof(values))
+        return false;
+
+    memcpy(counters, values + 1, 3 * sizeof(unsigned long long));
+
+    return true;
+}
+
+static unsigned long long wall_time(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+void decision_stats_begin(decision_phase p)
+{
+    if (perf_group == -2)
+        perf_setup();
+
+    perf_read(phase_starts[p].counters);
+
+    // The time is read last, not to count the reading of the counters.
+    phase_starts[p].ns = wall_time();
+}
+
+void decision_stats_end(decision_phase p)
+{
+    unsigned long long ns = wall_time();
+    unsigned long long counters[3];
+    phase_stats* s = &decision_last.phases[p];
+
+    s->runs++;
+    s->ns += ns - phase_starts[p].ns;
+
+    decision_last.hardware = perf_read(counters);
+
+    if (decision_last.hardware)
+    {
+        s->cycles += counters[0] - phase_starts[p].counters[0];
+        s->instructions += counters[1] - phase_starts[p].counters[1];
+        s->cache_misses += counters[2] - phase_starts[p].counters[2];
+    }
+}
+
+void decision_stats_add(decision_stats* to, const decision_stats* s)
+{
+    int p;
+
+    to->decisions += s->decisions;
+
+    for (p = 0; p < PHASE_COUNT; p++)
+    {
+        to->phases[p].runs += s->phases[p].runs;
+        to->phases[p].ns += s->phases[p].ns;
+        to->phases[p].cycles += s->phases[p].cycles;
+        to->phases[p].instructions += s->phases[p].instructions;
+        to->phases[p].cache_misses += s->phases[p].cache_misses;
+    }
+
+    to->pushes += s->pushes;
+    to->pops += s->pops;
+    to->expanded += s->expanded;
+    to->searches += s->searches;
+    to->hardware = s->hardware;
+}
+
+const char* decision_phase_name(decision_phase p)
+{
+    static const char* names[PHASE_COUNT] = {"create", "initialise", "update_graph", "shortest_paths", "next_move"};
+
+    return names[p];
+}
+#endif
+
+// **********************************************************************************
+// Linked list functions implementation
+// **********************************************************************************
+
+node* node_pool_acquire(node_pool* p)
+{
+    node* n;
+
+    // Reuse a node that was given back, if any.
+    if (p->free_nodes)
+    {
+        n = p->free_nodes;
+        p->free_nodes = n->next;
+
+        return n;
+    }
+
+    // Otherwise, hand out the next node of the most recent slab, allocating
+    // a new slab when it is exhausted.
+    if (!p->slabs || p->used == NODE_POOL_SLAB_SIZE)
+    {
+        node_slab* slab = tracked_malloc(sizeof(node_slab));
+        if (!slab) // Slab allocation failure, exit early
+            return NULL;
+
+        slab->next = p->slabs;
+        p->slabs = slab;
+        p->used = 0;
+    }
+
+    n = &p->slabs->nodes[p->used];
+    p->used++;
+
+    return n;
+}
+
+void node_pool_release(node_pool* p, node* n)
+{
+    // The node goes on top of the free list.
+    n->next = p->free_nodes;
+    p->free_nodes = n;
+}
+
+void node_pool_release_all(node_pool* p)
+{
+    // Only the slabs were allocated, not the nodes themselves.
+    while (p->slabs)
+    {
+        node_slab* next = p->slabs->next;
+        tracked_free(p->slabs);
+
+        p->slabs = next;
+    }
+
+    p->used = 0;
+    p->free_nodes = NULL;
+}
+
+list* list_new()
+{
+    list* l = tracked_malloc(sizeof(list));
+    l->first = NULL;
+    l->size = 0;
+    
+    // The pool is empty, its first slab will be allocated by the first insertion.
+    l->pool.slabs = NULL;
+    l->pool.used = 0;
+    l->pool.free_nodes = NULL;
+    
+    return l;
+}
+
+void list_delete(list* l)
+{
+    // All the nodes live in the slabs of the pool: there is no need to
+    // iterate through the list to free them one by one.
+    node_pool_release_all(&l->pool);
+    
+    tracked_free(l);
+}
+
+int list_size(list* l)
+{
+    return l->size;
+}
+
+int list_append(list* l, value v)
+{
+    // Appending an element is equivalent to
+    // insert it to the end of the list.
+    
+    list_iterator it = list_iterator_begin(l);
+    
+    while (!list_iterator_end(it))
+    {
+        it = list_iterator_next(it);
+    }
+    
+    // Here, it points to the latest element, which is NULL
+    
+    return list_insert(it, v);
+}
+
+int list_remove(list* l, int idx)
+{
+    // Don't try to remove an element out of the list.
+    if (idx >= l->size)
+        return 0;
+
+    int i;
+    
+    node* n = l->first;
+    
+    // Deleting the first element needs special attention: 
+    // we can't iterate until its predecessor, since it does 
+    // not have any.
+    if (idx == 0)
+    {
+        l->first = n->next;
+        node_pool_release(&l->pool, n);
+    }
+    else
+    {
+        // Iterate until the predecessor...
+        for (i = 0; i < idx - 1; i++)
+        {
+            n = n->next;
+        }
+        
+        // ...and swap the places before giving back the
+        // element to delete to the pool.
+        node* rip = n->next;
+        n->next = rip->next;
+        
+        node_pool_release(&l->pool, rip);
+    }
+    
+    // Don't forget to decrease the list size.
+    l->size--;
+    
+    return 1;
+}
+
+list_iterator list_iterator_begin(list* l)
+{
+    // Return an iterator object pointing to the first element
+    // of the list.
+    list_iterator beg = {l, &l->first};
+    return beg;
+}
+
+int list_iterator_end(list_iterator it)
+{
+    // Signal if the iterator has reached the end of the list.
+    return *it.ptr == NULL;
+}
+
+list_iterator list_iterator_next(list_iterator it)
+{
+    // Return a iterator pointing to the element following
+    // the one pointed by this iterator.
+    list_iterator next = {it.l, &(*it.ptr)->next};
+    return next;
+}
+
+int list_insert(list_iterator it, value v)
+{
+    // Insert a list node before the node pointed by
+    // the iterator.
+    
+    node* n = node_pool_acquire(&it.l->pool);
+    if (!n) // Node allocation failure, exit early
+        return 0;
+    
+    n->v = v; // Fill the actual value
+    
+    // Swap the places with current node.
+    n->next = *it.ptr;
+    *it.ptr = n;
+    
+    // Don't forget to increase the list size.
+    it.l->size++;
+    
+    return 1;
+}
+
+value list_iterator_get(list_iterator it)
+{
+    // Dereference the iterator to get the underlying value.
+    // One must check if the iterator points to a valid node
+    // before calling this function.
+    return (*it.ptr)->v;
+}
+
+// **********************************************************************************
+// Priority queue functions implementation
+// **********************************************************************************
+
+#if PRIORITY_QUEUE_IMPL == PRIORITY_QUEUE_LIST
+
+priority_queue* priority_queue_new(int(*cmp)(value, value))
+{
+    // Build a priority queue on top of a linked list.
+    priority_queue* q = tracked_malloc(sizeof(priority_queue));
+    q->l = list_new();
+    
+    // The order of elements will be determined by the comparator.
+    q->cmp_func = cmp;
+    
+    return q;
+}
+
+void priority_queue_delete(priority_queue* q)
+{
+    // To properly delete the priority queue, we must
+    // delete the underlying list too.
+    list_delete(q->l);
+    
+    tracked_free(q);
+}
+
+void priority_queue_clear(priority_queue* q)
+{
+    // Remove the nodes one by one from the front of the list.
+    while (list_remove(q->l, 0));
+}
+
+int priority_queue_size(priority_queue* q)
+{
+    // The priority queue size is the underlying list size.
+    return list_size(q->l);
+}
+
+void priority_queue_push(priority_queue* q, value v)
+{
+    DECISION_COUNT(pushes);
+
+    // Iterate through the list until we find the right place
+    // to insert the element. This shall be determined by the
+    // comparator function saved by the priority queue during
+    // its creation.
+    list_iterator it = list_iterator_begin(q->l);
+    
+    // While we are not at the end of the list, and the elements
+    // in the priority queue have lower priority than us
+    // (lowest priority means first), go to the next node.
+    while (!list_iterator_end(it) 
+        && q->cmp_func(list_iterator_get(it), v) < 0)
+    {
+        it = list_iterator_next(it);
+    }
+    
+    // We have arrived at the right place, insert the new element
+    // here. The priority queue remains sorted.
+    list_insert(it, v);
+}
+
+int priority_queue_pop(priority_queue* q)
+{
+    // Remove the first element in the priority queue, i.e. the one
+    // with the lowest priority. If none, just silently fail.
+    if (priority_queue_size(q) == 0)
+        return 0;
+
+    DECISION_COUNT(pops);
+    
+    return list_remove(q->l, 0);
+}
+
+int priority_queue_top(priority_queue* q, value* v)
+{
+    // Pass the first element in the priority queue, i.e. the one
+    // with the lowest priority by address to the caller.
+    //If none, signal that we could not extract any element.
+    
+    if (priority_queue_size(q) == 0)
+        return 0;
+    
+    // Get the first element.
+    *v = list_iterator_get(list_iterator_begin(q->l));
+    
+    return 1; // A valid value has been put in *v
+}
+
+#elif PRIORITY_QUEUE_IMPL == PRIORITY_QUEUE_HEAP
+
+priority_queue* priority_queue_new(int(*cmp)(value, value))
+{
+    // Build a priority queue on top of an array, which will grow as needed.
+    priority_queue* q = tracked_malloc(sizeof(priority_queue));
+
+    q->size = 0;
+    q->capacity = 64;
+    q->heap = tracked_malloc(q->capacity * sizeof(heap_entry));
+    q->pushes = 0;
+
+    // The slots array is indexed by graph node, it grows as bigger nodes are pushed.
+    q->slots_capacity = 64;
+    q->slots = tracked_malloc(q->slots_capacity * sizeof(int));
+    memset(q->slots, 0xff, q->slots_capacity * sizeof(int)); // No node is queued yet (-1)
+
+    // The order of elements will be determined by the comparator.
+    q->cmp_func = cmp;
+
+    return q;
+}
+
+void priority_queue_delete(priority_queue* q)
+{
+    // Free the arrays before the priority queue itself.
+    tracked_free(q->heap);
+    tracked_free(q->slots);
+
+    tracked_free(q);
+}
+
+void priority_queue_clear(priority_queue* q)
+{
+    int i;
+
+    // Only the slots of the graph nodes still queued need to be reset.
+    for (i = 0; i < q->size; i++)
+        q->slots[q->heap[i].v.index] = -1;
+
+    q->size = 0;
+    q->pushes = 0;
+}
+
+int priority_queue_size(priority_queue* q)
+{
+    return q->size;
+}
+
+bool priority_queue_before(priority_queue* q, heap_entry left, heap_entry right)
+{
+    int order = q->cmp_func(left.v, right.v);
+
+    return order < 0 || (order == 0 && left.push > right.push);
+}
+
+void priority_queue_sift_up(priority_queue* q, int i)
+{
+    heap_entry e = q->heap[i];
+
+    // Bring the parents down as long as the value comes before them...
+    while (i > 0 && priority_queue_before(q, e, q->heap[(i - 1) / 2]))
+    {
+        int parent = (i - 1) / 2;
+
+        q->heap[i] = q->heap[parent];
+        q->slots[q->heap[i].v.index] = i;
+
+        i = parent;
+    }
+
+    // ...and put the value in the hole that is left.
+    q->heap[i] = e;
+    q->slots[e.v.index] = i;
+}
+
+void priority_queue_sift_down(priority_queue* q, int i)
+{
+    heap_entry e = q->heap[i];
+
+    while (2 * i + 1 < q->size)
+    {
+        // Pick the child that comes first...
+        int child = 2 * i + 1;
+
+        if (child + 1 < q->size && priority_queue_before(q, q->heap[child + 1], q->heap[child]))
+            child++;
+
+        // ...and stop once the value comes before it.
+        if (!priority_queue_before(q, q->heap[child], e))
+            break;
+
+        q->heap[i] = q->heap[child];
+        q->slots[q->heap[i].v.index] = i;
+
+        i = child;
+    }
+
+    q->heap[i] = e;
+    q->slots[e.v.index] = i;
+}
+
+void priority_queue_push(priority_queue* q, value v)
+{
+    int slot;
+
+    DECISION_COUNT(pushes);
+
+    // Make room in the slots array for this graph node, if needed.
+    if (v.index >= q->slots_capacity)
+    {
+        int old_capacity = q->slots_capacity;
+
+        while (v.index >= q->slots_capacity)
+            q->slots_capacity *= 2;
+
+        q->slots = tracked_realloc(q->slots, q->slots_capacity * sizeof(int));
+        memset(q->slots + old_capacity, 0xff, (q->slots_capacity - old_capacity) * sizeof(int));
+    }
+
+    slot = q->slots[v.index];
+
+    if (slot != -1) // The graph node is already queued...
+    {
+        // ...so only lower its value, if the new one is better. The sorted list would
+        // keep the old value too, which the searches skip once the node is settled.
+        if (q->cmp_func(v, q->heap[slot].v) < 0)
+        {
+            q->heap[slot].v = v;
+            q->heap[slot].push = ++q->pushes;
+            priority_queue_sift_up(q, slot);
+        }
+    }
+    else
+    {
+        // Make room in the heap, if needed.
+        if (q->size == q->capacity)
+        {
+            q->capacity *= 2;
+            q->heap = tracked_realloc(q->heap, q->capacity * sizeof(heap_entry));
+        }
+
+        // Add the value as the last leaf, then restore the heap order.
+        q->heap[q->size].v = v;
+        q->heap[q->size].push = ++q->pushes;
+        q->size++;
+
+        priority_queue_sift_up(q, q->size - 1);
+    }
+}
+
+int priority_queue_pop(priority_queue* q)
+{
+    // Remove the root of the heap, i.e. the one with the lowest priority.
+    // If none, just silently fail.
+    if (q->size == 0)
+        return 0;
+
+    DECISION_COUNT(pops);
+
+    q->slots[q->heap[0].v.index] = -1; // This graph node leaves the queue.
+    q->size--;
+
+    // Move the last leaf to the root, then restore the heap order.
+    if (q->size > 0)
+    {
+        q->heap[0] = q->heap[q->size];
+        priority_queue_sift_down(q, 0);
+    }
+
+    return 1;
+}
+
+int priority_queue_top(priority_queue* q, value* v)
+{
+    // The root of the heap is the lowest element.
+    if (q->size == 0)
+        return 0;
+
+    *v = q->heap[0].v;
+
+    return 1; // A valid value has been put in *v
+}
+
+#elif PRIORITY_QUEUE_IMPL == PRIORITY_QUEUE_BUCKETS
+
+priority_queue* priority_queue_new(int(*cmp)(value, value))
+{
+    // Build a priority queue on top of empty buckets, the arrays indexed by graph
+    // node will grow as bigger nodes are pushed.
+    priority_queue* q = tracked_malloc(sizeof(priority_queue));
+
+    memset(q->heads, 0xff, sizeof(q->heads)); // Every bucket is empty (-1)
+
+    q->capacity = 0;
+    q->next = NULL;
+    q->prev = NULL;
+    q->keys = NULL;
+
+    q->size = 0;
+    q->lowest = 0;
+
+    q->cmp_func = cmp;
+
+    return q;
+}
+
+void priority_queue_delete(priority_queue* q)
+{
+    tracked_free(q->next);
+    tracked_free(q->prev);
+    tracked_free(q->keys);
+
+    tracked_free(q);
+}
+
+void priority_queue_clear(priority_queue* q)
+{
+    int b;
+
+    // Walk through the buckets that are not empty to forget the graph nodes
+    // still queued, then empty the buckets themselves.
+    for (b = 0; q->size > 0 && b < PRIORITY_QUEUE_BUCKET_COUNT; b++)
+    {
+        int index = q->heads[b];
+
+        while (index != -1)
+        {
+            q->keys[index] = -1;
+            q->size--;
+
+            index = q->next[index];
+        }
+    }
+
+    memset(q->heads, 0xff, sizeof(q->heads));
+
+    q->size = 0;
+    q->lowest = 0;
+}
+
+int priority_queue_size(priority_queue* q)
+{
+    return q->size;
+}
+
+void priority_queue_reserve(priority_queue* q, int index)
+{
+    int old_capacity = q->capacity;
+
+    if (index < q->capacity)
+        return;
+
+    if (q->capacity == 0)
+        q->capacity = 64;
+
+    while (index >= q->capacity)
+        q->capacity *= 2;
+
+    q->next = tracked_realloc(q->next, q->capacity * sizeof(int));
+    q->prev = tracked_realloc(q->prev, q->capacity * sizeof(int));
+    q->keys = tracked_realloc(q->keys, q->capacity * sizeof(int));
+
+    // The new graph nodes are not queued (-1).
+    memset(q->keys + old_capacity, 0xff, (q->capacity - old_capacity) * sizeof(int));
+}
+
+void priority_queue_unlink(priority_queue* q, int index)
+{
+    int b = q->keys[index] % PRIORITY_QUEUE_BUCKET_COUNT;
+
+    // Bypass the graph node in both directions of its bucket.
+    if (q->prev[index] == -1)
+        q->heads[b] = q->next[index];
+    else
+        q->next[q->prev[index]] = q->next[index];
+
+    if (q->next[index] != -1)
+        q->prev[q->next[index]] = q->prev[index];
+
+    q->keys[index] = -1;
+}
+
+void priority_queue_push(priority_queue* q, value v)
+{
+    int b = v.weight % PRIORITY_QUEUE_BUCKET_COUNT;
+
+    DECISION_COUNT(pushes);
+
+    priority_queue_reserve(q, v.index);
+
+    if (q->keys[v.index] != -1) // The graph node is already queued...
+    {
+        // ...so only move it to a lower bucket, if the new weight is better.
+        if (v.weight >= q->keys[v.index])
+            return;
+
+        priority_queue_unlink(q, v.index);
+    }
+    else
+    {
+        // The first value pushed in an empty queue sets the start of the buckets.
+        if (q->size == 0)
+            q->lowest = v.weight;
+
+        q->size++;
+    }
+
+    // Going round the buckets starts from the lowest weight in the queue.
+    if (v.weight < q->lowest)
+        q->lowest = v.weight;
+
+    // Insert the graph node at the head of its bucket.
+    q->keys[v.index] = v.weight;
+    q->prev[v.index] = -1;
+    q->next[v.index] = q->heads[b];
+
+    if (q->heads[b] != -1)
+        q->prev[q->heads[b]] = v.index;
+
+    q->heads[b] = v.index;
+}
+
+int priority_queue_top(priority_queue* q, value* v)
+{
+    if (q->size == 0)
+        return 0;
+
+    // Go round the buckets from the lowest weight, until one is not empty.
+    // All the graph nodes in a bucket share the same weight.
+    while (q->heads[q->lowest % PRIORITY_QUEUE_BUCKET_COUNT] == -1)
+        q->lowest++;
+
+    v->index = q->heads[q->lowest % PRIORITY_QUEUE_BUCKET_COUNT];
+    v->weight = q->lowest;
+
+    return 1; // A valid value has been put in *v
+}
+
+int priority_queue_pop(priority_queue* q)
+{
+    value v;
+
+    // Find the lowest graph node, then take it out of its bucket.
+    if (!priority_queue_top(q, &v))
+        return 0;
+
+    DECISION_COUNT(pops);
+
+    priority_queue_unlink(q, v.index);
+    q->size--;
+
+    return 1;
+}
+
+#endif
+
+// **********************************************************************************
+// Pathfinding functions implementation
+// **********************************************************************************
+
+void graph_set_weight(graph g, int idx, direction dir, unsigned char weight)
+{
+    // The int type in C language is at least 4 bytes long on most machines, 
+    // meaning we could interpret an int as a contiguous array of at least 4 bytes.
+    
+    // The weight value is coded as a char (1 byte long), so we can store 4 weight values
+    // in an int. As we have 4 directions to handle in our game, this is perfect.
+    // One might wonder about endianness when treating ints that way, but since we only
+    // manipulate bytes individually, this is needless worry.
+    
+    // g.ptr[idx] = |    0xff    |    0xff    |    0xff    |    0xff    |
+    //              | WEST weight|SOUTH weight| EAST weight|NORTH weight|
+    
+    g.ptr[idx] &= ~(0xffu << (dir * 8)); // Clean up the old value...
+    g.ptr[idx] |= ((unsigned int)weight << (dir * 8)); // ...before putting the new one.
+}
+
+unsigned char graph_get_weight(const graph g, int idx, direction dir)
+{
+    // In the same way, we access weights for a specific direction by bitshifting.
+    return (g.ptr[idx] >> (dir * 8)) & 0xff;
+}
+
+vec2 create_vec2(int x, int y)
+{
+    // This function places x in the x field of vec2, and y in its y field
+    // (order sensitive). This is useful as the version of C used does not support
+    // brace initialisation directly passed as a parameter to a function.
+    vec2 p = {x, y};
+    return p;
+}
+
+vec2 wrap_coordinates(int w, int h, vec2 p)
+{
+    // Be cautious we never go out of the map, and mirror the
+    // coordinate that overflows accordingly.
+    vec2 n = p;
+    
+    if (n.y < 0)
+        n.y += h;
+    if (n.y >= h)
+        n.y -= h;
+    if (n.x < 0)
+        n.x += w;
+    if (n.x >= w)
+        n.x -= w;
+    
+    return n;
+}
+
+vec2 graph_index_to_coords(int idx, int w)
+{
+    // This function converts the indexing system used by the graph
+    // to the 2-dimensional system used by the game.
+    vec2 r = {idx % w, idx / w};
+    return r;
+}
+
+unsigned int coords_to_graph_index(vec2 pos, int w)
+{
+    // This function coverts the 2-dimensional coordinate system used
+    // by the game to the indexing system used by the graph.
+    return pos.y * w + pos.x;
+}
+
+unsigned int graph_get_neighbor_index(int w, int h, int src, direction dir)
+{
+    // Get the graph index of the neighbor of src in the given direction.
+    // This is easily done by converting the graph index to the game coordinates...
+    vec2 p = graph_index_to_coords(src, w);
+    
+    // We change the coordinates accordingly.
+    switch (dir)
+    {
+        case NORTH:
+            p.y--;
+            break;
+        case EAST:
+            p.x++;
+            break;
+        case SOUTH:
+            p.y++;
+            break;
+        case WEST:
+            p.x--;
+            break;
+    }
+    
+    // ...and then reverting back to the graph indexing system, without forgetting
+    // to mirror the coordinates if they ever overflowed.
+    return coords_to_graph_index(wrap_coordinates(w, h, p), w);
+}
+
+unsigned char get_weight_for_entity(char c, entities_weights config)
+{
+    // This function essentially associate a game entity with its weight,
+    // following what we wanted to set for each entity.
+    unsigned char w;
+    
+    if (c == VIRGIN_PATH)
+    {
+        w = config.unexplored;
+    }
+    else if (c == PATH)
+    {
+        w = config.explored;
+    }
+    else if (c == ENERGY)
+    {
+        w = config.energizer;
+    }
+    else if (c == GHOST1
+        || c == GHOST2
+        || c == GHOST3
+        || c == GHOST4)
+    {
+        // The ghosts have all the same weight.
+        w = config.ghost;
+    }
+    else
+    {
+        // Walls and the Door are impossible to pass through.
+        w = 255;
+    }
+    
+    return w;
+}
+
+void build_weight_table(entities_weights config, unsigned char* table)
+{
+    // Looking a character up in this table replaces the chain of comparisons above.
+    int c;
+
+    for (c = 0; c < 256; c++)
+        table[c] = get_weight_for_entity((char)c, config);
+}
+
+void classify_row(const char* row, int w, entities_weights config, const unsigned char* table,
+    unsigned char* weights)
+{
+    int x = 0;
+
+#if MAP_KERNEL_IMPL == MAP_KERNEL_AVX2
+    // Compare 32 characters at once against each entity: a matching byte becomes 0xff
+    // in the mask, which selects the weight of the entity. The positions that match no
+    // entity are walls or the Door, impossible to pass through.
+    __m256i unexplored = _mm256_set1_epi8((char)config.unexplored);
+    __m256i explored = _mm256_set1_epi8((char)config.explored);
+    __m256i energizer = _mm256_set1_epi8((char)config.energizer);
+    __m256i ghost = _mm256_set1_epi8((char)config.ghost);
+    __m256i blocked = _mm256_set1_epi8((char)255);
+
+    for (; x + 32 <= w; x += 32)
+    {
+        __m256i c = _mm256_loadu_si256((const __m256i*)(row + x));
+        __m256i is_unexplored = _mm256_cmpeq_epi8(c, _mm256_set1_epi8(VIRGIN_PATH));
+        __m256i is_explored = _mm256_cmpeq_epi8(c, _mm256_set1_epi8(PATH));
+        __m256i is_energizer = _mm256_cmpeq_epi8(c, _mm256_set1_epi8(ENERGY));
+        __m256i is_ghost = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(GHOST1)), _mm256_cmpeq_epi8(c, _mm256_set1_epi8(GHOST2))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(GHOST3)), _mm256_cmpeq_epi8(c, _mm256_set1_epi8(GHOST4))));
+        __m256i any = _mm256_or_si256(_mm256_or_si256(is_unexplored, is_explored), _mm256_or_si256(is_energizer, is_ghost));
+        __m256i r = _mm256_andnot_si256(any, blocked);
+
+        r = _mm256_or_si256(r, _mm256_and_si256(is_unexplored, unexplored));
+        r = _mm256_or_si256(r, _mm256_and_si256(is_explored, explored));
+        r = _mm256_or_si256(r, _mm256_and_si256(is_energizer, energizer));
+        r = _mm256_or_si256(r, _mm256_and_si256(is_ghost, ghost));
+
+        _mm256_storeu_si256((__m256i*)(weights + x), r);
+    }
+#elif MAP_KERNEL_IMPL == MAP_KERNEL_SSE2
+    // Compare 16 characters at once against each entity: a matching byte becomes 0xff
+    // in the mask, which selects the weight of the entity. The positions that match no
+    // entity are walls or the Door, impossible to pass through.
+    __m128i unexplored = _mm_set1_epi8((char)config.unexplored);
+    __m128i explored = _mm_set1_epi8((char)config.explored);
+    __m128i energizer = _mm_set1_epi8((char)config.energizer);
+    __m128i ghost = _mm_set1_epi8((char)config.ghost);
+    __m128i blocked = _mm_set1_epi8((char)255);
+
+    for (; x + 16 <= w; x += 16)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i*)(row + x));
+        __m128i is_unexplored = _mm_cmpeq_epi8(c, _mm_set1_epi8(VIRGIN_PATH));
+        __m128i is_explored = _mm_cmpeq_epi8(c, _mm_set1_epi8(PATH));
+        __m128i is_energizer = _mm_cmpeq_epi8(c, _mm_set1_epi8(ENERGY));
+        __m128i is_ghost = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(GHOST1)), _mm_cmpeq_epi8(c, _mm_set1_epi8(GHOST2))),
+            _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(GHOST3)), _mm_cmpeq_epi8(c, _mm_set1_epi8(GHOST4))));
+        __m128i any = _mm_or_si128(_mm_or_si128(is_unexplored, is_explored), _mm_or_si128(is_energizer, is_ghost));
+        __m128i r = _mm_andnot_si128(any, blocked);
+
+        r = _mm_or_si128(r, _mm_and_si128(is_unexplored, unexplored));
+        r = _mm_or_si128(r, _mm_and_si128(is_explored, explored));
+        r = _mm_or_si128(r, _mm_and_si128(is_energizer, energizer));
+        r = _mm_or_si128(r, _mm_and_si128(is_ghost, ghost));
+
+        _mm_storeu_si128((__m128i*)(weights + x), r);
+    }
+#else
+    (void)config; // The table does all the work
+#endif
+
+    // The end of the row, or the whole of it without vector instructions.
+    for (; x < w; x++)
+        weights[x] = table[(unsigned char)row[x]];
+}
+
+void pack_neighbor_weights(const unsigned char* north, const unsigned char* row,
+    const unsigned char* south, int w, unsigned int* out)
+{
+    // With the padding, position x of the row is at x + 1 in the buffers: its east
+    // neighbor is at x + 2, and its west one at x.
+    int x = 0;
+
+#if MAP_KERNEL_IMPL == MAP_KERNEL_AVX2
+    // Interleave the four planes of weights byte by byte, so that each group of four
+    // bytes is laid out in memory as graph_set_weight would have put it (x86 machines
+    // are little-endian). The unpacking instructions work within each 128-bit half,
+    // which the final permutations put back in order.
+    for (; x + 32 <= w; x += 32)
+    {
+        __m256i n = _mm256_loadu_si256((const __m256i*)(north + x + 1));
+        __m256i e = _mm256_loadu_si256((const __m256i*)(row + x + 2));
+        __m256i s = _mm256_loadu_si256((const __m256i*)(south + x + 1));
+        __m256i wv = _mm256_loadu_si256((const __m256i*)(row + x));
+
+        __m256i ne_lo = _mm256_unpacklo_epi8(n, e);
+        __m256i ne_hi = _mm256_unpackhi_epi8(n, e);
+        __m256i sw_lo = _mm256_unpacklo_epi8(s, wv);
+        __m256i sw_hi = _mm256_unpackhi_epi8(s, wv);
+
+        __m256i a = _mm256_unpacklo_epi16(ne_lo, sw_lo); // Positions 0-3 and 16-19
+        __m256i b = _mm256_unpackhi_epi16(ne_lo, sw_lo); // Positions 4-7 and 20-23
+        __m256i c = _mm256_unpacklo_epi16(ne_hi, sw_hi); // Positions 8-11 and 24-27
+        __m256i d = _mm256_unpackhi_epi16(ne_hi, sw_hi); // Positions 12-15 and 28-31
+
+        _mm256_storeu_si256((__m256i*)(out + x), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i*)(out + x + 8), _mm256_permute2x128_si256(c, d, 0x20));
+        _mm256_storeu_si256((__m256i*)(out + x + 16), _mm256_permute2x128_si256(a, b, 0x31));
+        _mm256_storeu_si256((__m256i*)(out + x + 24), _mm256_permute2x128_si256(c, d, 0x31));
+    }
+#elif MAP_KERNEL_IMPL == MAP_KERNEL_SSE2
+    // Interleave the four planes of weights byte by byte, so that each group of four
+    // bytes is laid out in memory as graph_set_weight would have put it (x86 machines
+    // are little-endian).
+    for (; x + 16 <= w; x += 16)
+    {
+        __m128i n = _mm_loadu_si128((const __m128i*)(north + x + 1));
+        __m128i e = _mm_loadu_si128((const __m128i*)(row + x + 2));
+        __m128i s = _mm_loadu_si128((const __m128i*)(south + x + 1));
+        __m128i wv = _mm_loadu_si128((const __m128i*)(row + x));
+
+        __m128i ne_lo = _mm_unpacklo_epi8(n, e);
+        __m128i ne_hi = _mm_unpackhi_epi8(n, e);
+        __m128i sw_lo = _mm_unpacklo_epi8(s, wv);
+        __m128i sw_hi = _mm_unpackhi_epi8(s, wv);
+
+        _mm_storeu_si128((__m128i*)(out + x), _mm_unpacklo_epi16(ne_lo, sw_lo));
+        _mm_storeu_si128((__m128i*)(out + x + 4), _mm_unpackhi_epi16(ne_lo, sw_lo));
+        _mm_storeu_si128((__m128i*)(out + x + 8), _mm_unpacklo_epi16(ne_hi, sw_hi));
+        _mm_storeu_si128((__m128i*)(out + x + 12), _mm_unpackhi_epi16(ne_hi, sw_hi));
+    }
+#endif
+
+    // The end of the row, or the whole of it without vector instructions.
+    for (; x < w; x++)
+    {
+        out[x] = (unsigned int)north[x + 1] << (NORTH * 8)
+            | (unsigned int)row[x + 2] << (EAST * 8)
+            | (unsigned int)south[x + 1] << (SOUTH * 8)
+            | (unsigned int)row[x] << (WEST * 8);
+    }
+}
+
+graph create_graph(char** map, int width, int height)
+{
+    // Create a reusable graph structure, much more easily modifiable 
+    // than the map itself.
+    // Each element in the graph will match a unique position on the map.
+    // This is assured by the existence and unicity of the Euclidean division:
+    //      - graph_idx = y * width + x
+    //      - {x = graph_idx % width, y = graph_idx / width}
+    graph g;
+    
+    g.ptr = tracked_malloc(width * height * sizeof(unsigned int));
+    g.map = map;
+    g.w = width;
+    g.h = height;
+    g.adj = create_adjacency(map, width, height);
+    g.flood = flood_fill_create(&g.adj, width, height);
+    g.rows = tracked_malloc(3 * (width + 2));
+
+#if PATHFINDING_IMPL == PATHFINDING_JUNCTION_GRAPH
+    g.junctions = create_junction_graph(&g.adj);
+#elif PATHFINDING_IMPL == PATHFINDING_DISTANCE_TABLE
+    g.table = distance_table_acquire(&g.adj, width, height);
+#endif
+    
+    memset(g.ptr, 0, width * height * sizeof(unsigned int));
+        
+    return g;
+}
+
+adjacency create_adjacency(char** map, int w, int h)
+{
+    // Number the positions Pacman can walk on, then list the neighbors of each
+    // of them, node after node.
+    adjacency adj;
+
+    int i, dir;
+    int edge_count = 0;
+
+    adj.cell_to_node = tracked_malloc(w * h * sizeof(int));
+    adj.node_count = 0;
+
+    for (i = 0; i < w * h; i++)
+    {
+        vec2 p = graph_index_to_coords(i, w);
+
+        if (map[p.y][p.x] == WALL || map[p.y][p.x] == DOOR)
+        {
+            adj.cell_to_node[i] = -1;
+        }
+        else
+        {
+            adj.cell_to_node[i] = adj.node_count;
+            adj.node_count++;
+        }
+    }
+
+    adj.node_to_cell = tracked_malloc(adj.node_count * sizeof(int));
+    adj.positions = tracked_malloc(adj.node_count * sizeof(vec2));
+    adj.offsets = tracked_malloc((adj.node_count + 1) * sizeof(int));
+
+    // Every node has at most four neighbors.
+    adj.targets = tracked_malloc(4 * adj.node_count * sizeof(int));
+    adj.directions = tracked_malloc(4 * adj.node_count);
+
+    for (i = 0; i < w * h; i++)
+    {
+        int node = adj.cell_to_node[i];
+
+        if (node == -1)
+            continue;
+
+        adj.node_to_cell[node] = i;
+        adj.positions[node] = graph_index_to_coords(i, w);
+        adj.offsets[node] = edge_count;
+
+        // The mirroring of the borders is resolved here once and for all.
+        for (dir = 0; dir < 4; dir++)
+        {
+            int neighbor = adj.cell_to_node[graph_get_neighbor_index(w, h, i, dir)];
+
+            if (neighbor != -1) // Walls and the Door are not neighbors
+            {
+                adj.targets[edge_count] = neighbor;
+                adj.directions[edge_count] = dir;
+                edge_count++;
+            }
+        }
+    }
+
+    adj.offsets[adj.node_count] = edge_count;
+
+    return adj;
+}
+
+void dispose_adjacency(adjacency adj)
+{
+    // Release the resources held by the adjacency.
+    tracked_free(adj.cell_to_node);
+    tracked_free(adj.node_to_cell);
+    tracked_free(adj.positions);
+    tracked_free(adj.offsets);
+    tracked_free(adj.targets);
+    tracked_free(adj.directions);
+}
+
+int graph_get_node(const graph g, vec2 pos)
+{
+    // Entities that could not be located (e.g. a ghost hidden by another one)
+    // are given a position out of the map: there is no node there.
+    if (pos.x < 0 || pos.x >= g.w || pos.y < 0 || pos.y >= g.h)
+        return -1;
+
+    return g.adj.cell_to_node[coords_to_graph_index(pos, g.w)];
+}
+
+unsigned char graph_get_node_weight(const graph g, int node)
+{
+    // Read the weight on the way back from any neighbor: going one way and then the
+    // opposite way always leads back, even across the borders.
+    int e = g.adj.offsets[node];
+
+    if (e == g.adj.offsets[node + 1])
+        return 255;
+
+    return graph_get_weight(g, g.adj.node_to_cell[g.adj.targets[e]], (g.adj.directions[e] + 2) % 4);
+}
+
+void update_graph(graph g, entities_weights config)
+{
+    // Populate the provided graph row by row: the weight to go from a position to
+    // one of its neighbors is the weight of the entity on the neighbor, so each row
+    // of the map is classified once, then its weights are shifted into the four
+    // directions of the positions around it.
+    unsigned char table[256];
+    unsigned char* north = g.rows;
+    unsigned char* row = g.rows + (g.w + 2);
+    unsigned char* south = g.rows + 2 * (g.w + 2);
+    int j;
+
+    build_weight_table(config, table);
+
+    // The row above the first one is the last one, by mirroring.
+    classify_row(g.map[g.h - 1], g.w, config, table, north + 1);
+    classify_row(g.map[0], g.w, config, table, row + 1);
+
+    north[0] = north[g.w];
+    north[g.w + 1] = north[1];
+    row[0] = row[g.w];
+    row[g.w + 1] = row[1];
+
+    for (j = 0; j < g.h; j++)
+    {
+        unsigned char* spare;
+
+        // The row below the last one is the first one, by mirroring.
+        classify_row(g.map[(j + 1) % g.h], g.w, config, table, south + 1);
+        south[0] = south[g.w];
+        south[g.w + 1] = south[1];
+
+        pack_neighbor_weights(north, row, south, g.w, g.ptr + g.w * j);
+
+        // Move one row down, reusing the buffer of the row that is no longer needed.
+        spare = north;
+        north = row;
+        row = south;
+        south = spare;
+    }
+
+#if PATHFINDING_IMPL == PATHFINDING_JUNCTION_GRAPH
+    memcpy(g.junctions->table, table, sizeof(table));
+    junction_graph_reset(g.junctions);
+#endif
+}
+
+int compare_weights(value left, value right)
+{
+    // Compare the weight values to sort nodes in the priority queue.
+    return left.weight - right.weight;
+}
+
+search_arena* search_arena_create(int w, int h)
+{
+    // The records are allocated in the same fashion as the graph: one per graph position.
+    search_arena* a = tracked_malloc(sizeof(search_arena));
+
+    a->records = tracked_malloc(w * h * sizeof(search_record));
+    a->queue = priority_queue_new(compare_weights);
+    a->w = w;
+    a->h = h;
+
+    // Stamp 0 is never used by a search, so zeroed records are all stale.
+    memset(a->records, 0, w * h * sizeof(search_record));
+    a->stamp = 0;
+
+#if SHORTEST_PATH_IMPL == SHORTEST_PATH_BIDIRECTIONAL
+    a->back_records = tracked_malloc(w * h * sizeof(search_record));
+    a->back_queue = priority_queue_new(compare_weights);
+
+    memset(a->back_records, 0, w * h * sizeof(search_record));
+#endif
+
+    return a;
+}
+
+void search_arena_begin(search_arena* a)
+{
+    // A new stamp makes all the records written so far stale at once.
+    a->stamp++;
+
+    // After four billion searches the stamps wrap around: clear the records
+    // for real so that an old stamp cannot be mistaken for the current one.
+    if (a->stamp == 0)
+    {
+        memset(a->records, 0, a->w * a->h * sizeof(search_record));
+#if SHORTEST_PATH_IMPL == SHORTEST_PATH_BIDIRECTIONAL
+        memset(a->back_records, 0, a->w * a->h * sizeof(search_record));
+#endif
+        a->stamp = 1;
+    }
+
+    priority_queue_clear(a->queue);
+#if SHORTEST_PATH_IMPL == SHORTEST_PATH_BIDIRECTIONAL
+    priority_queue_clear(a->back_queue);
+#endif
+    a->expanded = 0;
+
+    DECISION_COUNT(searches);
+}
+
+search_record* search_arena_get(search_arena* a, int idx)
+{
+    search_record* r = &a->records[idx];
+
+    // Blank the record the first time it is accessed during this search.
+    if (r->stamp != a->stamp)
+    {
+        r->stamp = a->stamp;
+        r->distance = -1;
+        r->size = -1;
+        r->first_step = idx;
+        r->settled = false;
+    }
+
+    return r;
+}
+
+#if SHORTEST_PATH_IMPL == SHORTEST_PATH_BIDIRECTIONAL
+search_record* search_arena_get_back(search_arena* a, int idx)
+{
+    search_record* r = &a->back_records[idx];
+
+    // The backward records share the stamps of the forward ones.
+    if (r->stamp != a->stamp)
+    {
+        r->stamp = a->stamp;
+        r->distance = -1;
+        r->size = -1;
+        r->first_step = idx;
+        r->settled = false;
+    }
+
+    return r;
+}
+#endif
+
+path_result search_arena_get_path(const graph g, search_arena* a, vec2 target)
+{
+    // Reading a path is a simple lookup in the records of the last search.
+    search_record* r;
+    int node = graph_get_node(g, target);
+
+    // There is no path to a position that is not a node.
+    if (node == -1)
+    {
+        path_result none = {target, -1, -1};
+        return none;
+    }
+
+    r = search_arena_get(a, node);
+
+    path_result res = {
+        g.adj.positions[r->first_step],
+        r->distance,
+        r->size
+    };
+
+    return res;
+}
+
+void search_arena_destroy(search_arena* a)
+{
+    // Release the resources held by the search arena.
+    tracked_free(a->records);
+    priority_queue_delete(a->queue);
+
+#if SHORTEST_PATH_IMPL == SHORTEST_PATH_BIDIRECTIONAL
+    tracked_free(a->back_records);
+    priority_queue_delete(a->back_queue);
+#endif
+
+    tracked_free(a);
+}
+
+void dijkstra(const graph g, search_arena* a, vec2 source, int dest)
+{
+    // An adapted implementation of the Dijkstra's algorithm.
+    // Rather than rebuilding the path backwards from the target once it is found,
+    // every node remembers the first step taken from the source to reach it,
+    // and the raw size of its path.
+
+    // Some aliases for less typing
+    const adjacency* adj = &g.adj;
+
+    int e; // Define some iterators
+
+    priority_queue* q = a->queue; // The priority queue to extract the nodes to analyse from
+    search_record* r; // The record of the node being analysed
+
+    int src = graph_get_node(g, source); // The node of the source
+
+    search_arena_begin(a);
+
+    if (src == -1) // Nothing can be reached from a wall.
+        return;
+
+    // The distance from the source to the source is 0.
+    r = search_arena_get(a, src);
+    r->distance = 0;
+    r->size = 0;
+    r->first_step = src;
+
+    // Add the source element with a zero weight to the priority queue.
+    // This shall be our starting point.
+    value orig = {src, 0};
+    priority_queue_push(q, orig);
+
+    while (priority_queue_size(q) > 0)
+    {
+        // Grab the topmost element in the priority queue.
+        value c;
+        priority_queue_top(q, &c);
+        priority_queue_pop(q);
+
+        r = search_arena_get(a, c.index);
+
+        // A node may have been queued several times with decreasing costs,
+        // only the first extraction (the cheapest) is relevant.
+        if (r->settled)
+            continue;
+
+        r->settled = true;
+        a->expanded++;
+        DECISION_COUNT(expanded);
+
+        if (c.index == dest) // If we reached the destination, we are done.
+            break;
+
+        // The weights are stored by graph position.
+        unsigned int weights = g.ptr[adj->node_to_cell[c.index]];
+
+        // Otherwise, let us visit every neighbor of this node.
+        for (e = adj->offsets[c.index]; e < adj->offsets[c.index + 1]; e++)
+        {
+            unsigned char weight = (weights >> (adj->directions[e] * 8)) & 0xff;
+
+            // Some entities can never be crossed.
+            if (weight == 255)
+                continue;
+
+            int neighbor = adj->targets[e];
+            search_record* n = search_arena_get(a, neighbor);
+            int cost = r->distance + weight;
+
+            // See if going to this neighbor is cheaper than before...
+            if (!n->settled && (n->distance == -1 || cost < n->distance))
+            {
+                n->distance = cost;
+                n->size = r->size + 1;
+
+                // The first step is inherited from the predecessor, except for the
+                // direct neighbors of the source which are their own first step.
+                n->first_step = c.index == src ? (map_index)neighbor : r->first_step;
+
+                // Add this neighbor to the queue to visit it later.
+                value v = {neighbor, cost};
+                priority_queue_push(q, v);
+            }
+        }
+    }
+}
+
+path_result shortest_path(const graph g, search_arena* a, vec2 source, vec2 target)
+{
+#if PATHFINDING_IMPL == PATHFINDING_JUNCTION_GRAPH
+    // Searching the junctions is cheap enough not to bother stopping early.
+    junction_graph_search(g, a, source);
+
+    return junction_graph_get_path(g, a, target);
+#elif PATHFINDING_IMPL == PATHFINDING_DISTANCE_TABLE
+    // A single target is a particular case of several.
+    path_result res;
+
+    compute_shortest_paths(g, a, source, &target, 1, &res);
+
+    return res;
+#else
+    // Stop the search as soon as the target is reached...
+#if SHORTEST_PATH_IMPL == SHORTEST_PATH_BIDIRECTIONAL
+    // ...which happens once both searches have met: the path is made of both halves.
+    return bidirectional_dijkstra(g, a, source, target);
+#elif SHORTEST_PATH_IMPL == SHORTEST_PATH_ASTAR
+    astar(g, a, source, target);
+#elif SHORTEST_PATH_IMPL == SHORTEST_PATH_DIJKSTRA
+    dijkstra(g, a, source, graph_get_node(g, target));
+#else
+#error "Unknown SHORTEST_PATH_IMPL"
+#endif
+
+    // ...and read the path it left in the arena.
+    return search_arena_get_path(g, a, target);
+#endif
+}
+
+int toroidal_distance(int w, int h, vec2 from, vec2 to)
+{
+    // On each axis, either go straight or go the other way round across the border.
+    int dx = from.x > to.x ? from.x - to.x : to.x - from.x;
+    int dy = from.y > to.y ? from.y - to.y : to.y - from.y;
+
+    if (w - dx < dx)
+        dx = w - dx;
+    if (h - dy < dy)
+        dy = h - dy;
+
+    return dx + dy;
+}
+
+void astar(const graph g, search_arena* a, vec2 source, vec2 target)
+{
+    // The same search as the Dijkstra's algorithm, except that the nodes are queued by
+    // their distance from the source plus their toroidal distance to the target. As this
+    // estimate never decreases by more than the weight of a step, the nodes are still
+    // settled for good the first time they are extracted.
+    const adjacency* adj = &g.adj;
+
+    int e;
+
+    priority_queue* q = a->queue;
+    search_record* r;
+
+    int src = graph_get_node(g, source);
+    int dest = graph_get_node(g, target);
+
+    search_arena_begin(a);
+
+    if (src == -1 || dest == -1) // There is no path from or to a wall.
+        return;
+
+    r = search_arena_get(a, src);
+    r->distance = 0;
+    r->size = 0;
+    r->first_step = src;
+
+    value orig = {src, toroidal_distance(g.w, g.h, source, target)};
+    priority_queue_push(q, orig);
+
+    while (priority_queue_size(q) > 0)
+    {
+        value c;
+        priority_queue_top(q, &c);
+        priority_queue_pop(q);
+
+        r = search_arena_get(a, c.index);
+
+        if (r->settled)
+            continue;
+
+        r->settled = true;
+        a->expanded++;
+        DECISION_COUNT(expanded);
+
+        if (c.index == dest)
+            break;
+
+        unsigned int weights = g.ptr[adj->node_to_cell[c.index]];
+
+        for (e = adj->offsets[c.index]; e < adj->offsets[c.index + 1]; e++)
+        {
+            unsigned char weight = (weights >> (adj->directions[e] * 8)) & 0xff;
+
+            if (weight == 255)
+                continue;
+
+            int neighbor = adj->targets[e];
+            search_record* n = search_arena_get(a, neighbor);
+            int cost = r->distance + weight;
+
+            if (!n->settled && (n->distance == -1 || cost < n->distance))
+            {
+                n->distance = cost;
+                n->size = r->size + 1;
+                n->first_step = c.index == src ? (map_index)neighbor : r->first_step;
+
+                value v = {neighbor, cost + toroidal_distance(g.w, g.h, adj->positions[neighbor], target)};
+                priority_queue_push(q, v);
+            }
+        }
+    }
+}
+
+#if SHORTEST_PATH_IMPL == SHORTEST_PATH_BIDIRECTIONAL
+int bidirectional_distance_left(const graph g, search_arena* a, int node, vec2 target, int back_top)
+{
+    // Exactly the distance of the node if the backward search settled it, else the lowest
+    // distance it had left to settle, and 1 per step. A node it could not reach once it
+    // ran out of nodes cannot reach the target at all.
+    search_record* back = search_arena_get_back(a, node);
+    int left;
+
+    if (back->settled)
+        return back->distance;
+
+    if (back_top == -1)
+        return -1;
+
+    left = toroidal_distance(g.w, g.h, g.adj.positions[node], target);
+
+    return left < back_top ? back_top : left;
+}
+
+path_result bidirectional_dijkstra(const graph g, search_arena* a, vec2 source, vec2 target)
+{
+    // Both searches settle their nodes in turn, the one with the fewest nodes queued going
+    // first: a search that is stuck (e.g. in the ghost house) runs out of nodes quickly,
+    // instead of letting the other one go through the whole map. The backward search goes
+    // through the edges the other way round: the distance of a node is then the cost of
+    // going from it to the target.
+    // Every edge between a node reached forwards and a node reached backwards joins a
+    // path from the source to the target: the cheapest one found so far is kept. Once
+    // the distances left to settle on both sides add up to at least its cost, no path
+    // can be cheaper.
+    // When several paths are as cheap, the unidirectional search goes the way of the one
+    // it settles first. The forward search goes on to find it, through the nodes that
+    // can still be on a cheapest path (see below).
+    const adjacency* adj = &g.adj;
+
+    int e;
+
+    path_result res = {target, -1, -1};
+    search_record* r;
+
+    int src = graph_get_node(g, source);
+    int dest = graph_get_node(g, target);
+
+    int best = -1; // The cost of the cheapest path found so far, -1 if none
+    int back_top = -1; // The lowest distance left to settle backwards, -1 if none
+
+    search_arena_begin(a);
+
+    if (src == -1 || dest == -1)
+        return res;
+
+    if (src == dest)
+    {
+        res.distance = 0;
+        res.size = 0;
+        return res;
+    }
+
+    r = search_arena_get(a, src);
+    r->distance = 0;
+    r->size = 0;
+    r->first_step = src;
+
+    r = search_arena_get_back(a, dest);
+    r->distance = 0;
+    r->size = 0;
+    r->first_step = dest;
+
+    value orig = {src, 0};
+    priority_queue_push(a->queue, orig);
+
+    value end = {dest, 0};
+    priority_queue_push(a->back_queue, end);
+
+    while (priority_queue_size(a->queue) > 0 && priority_queue_size(a->back_queue) > 0)
+    {
+        value f, b, c;
+        bool forward;
+        search_record* n;
+
+        priority_queue_top(a->queue, &f);
+        priority_queue_top(a->back_queue, &b);
+
+        if (best != -1 && f.weight + b.weight >= best)
+            break;
+
+        forward = priority_queue_size(a->queue) <= priority_queue_size(a->back_queue);
+
+        c = forward ? f : b;
+        priority_queue_pop(forward ? a->queue : a->back_queue);
+
+        r = forward ? search_arena_get(a, c.index) : search_arena_get_back(a, c.index);
+
+        if (r->settled)
+            continue;
+
+        r->settled = true;
+        a->expanded++;
+        DECISION_COUNT(expanded);
+
+        if (forward)
+        {
+            unsigned int weights = g.ptr[adj->node_to_cell[c.index]];
+
+            for (e = adj->offsets[c.index]; e < adj->offsets[c.index + 1]; e++)
+            {
+                unsigned char weight = (weights >> (adj->directions[e] * 8)) & 0xff;
+
+                if (weight == 255)
+                    continue;
+
+                int neighbor = adj->targets[e];
+                int cost = r->distance + weight;
+
+                n = search_arena_get(a, neighbor);
+
+                if (!n->settled && (n->distance == -1 || cost < n->distance))
+                {
+                    n->distance = cost;
+                    n->size = r->size + 1;
+                    n->first_step = c.index == src ? (map_index)neighbor : r->first_step;
+
+                    value v = {neighbor, cost};
+                    priority_queue_push(a->queue, v);
+                }
+
+                // Does this edge join both searches?
+                n = search_arena_get_back(a, neighbor);
+
+                if (n->distance != -1 && (best == -1 || cost + n->distance < best))
+                    best = cost + n->distance;
+            }
+        }
+        else
+        {
+            // Entering this node costs the same from every neighbor.
+            unsigned char weight = graph_get_node_weight(g, c.index);
+            int cost = r->distance + weight;
+
+            if (weight == 255)
+                continue;
+
+            for (e = adj->offsets[c.index]; e < adj->offsets[c.index + 1]; e++)
+            {
+                int neighbor = adj->targets[e];
+
+                n = search_arena_get_back(a, neighbor);
+
+                if (!n->settled && (n->distance == -1 || cost < n->distance))
+                {
+                    n->distance = cost;
+                    n->size = r->size + 1;
+                    n->first_step = c.index;
+
+                    value v = {neighbor, cost};
+                    priority_queue_push(a->back_queue, v);
+                }
+
+                n = search_arena_get(a, neighbor);
+
+                if (n->distance != -1 && (best == -1 || n->distance + cost < best))
+                    best = n->distance + cost;
+            }
+        }
+    }
+
+    if (best == -1)
+        return res;
+
+    // The forward search settles its nodes in the same order as the unidirectional one,
+    // with the same queue. Among the nodes of equal distance, the queue pops the one
+    // pushed last first: the nodes on a cheapest path are pushed by nodes on a cheapest
+    // path, so the order in which they are settled does not depend on the other nodes.
+    // Going on without the nodes that cannot be on a cheapest path thus settles the
+    // target with the same first step and size as the unidirectional search. A node
+    // cannot be on a cheapest path if its distance from the source, plus what going from
+    // it to the target costs at least, is more than the cost of the cheapest path: this
+    // is known exactly for the nodes settled backwards; every other node costs at least
+    // the lowest distance left backwards, and 1 per step.
+    if (priority_queue_top(a->back_queue, &end))
+        back_top = end.weight;
+
+    while (priority_queue_size(a->queue) > 0)
+    {
+        value c;
+        int left;
+
+        priority_queue_top(a->queue, &c);
+        priority_queue_pop(a->queue);
+
+        r = search_arena_get(a, c.index);
+
+        if (r->settled)
+            continue;
+
+        // Nodes queued before the searches met can be off every cheapest path too.
+        left = bidirectional_distance_left(g, a, c.index, target, back_top);
+
+        if (left == -1 || r->distance + left > best)
+            continue;
+
+        r->settled = true;
+        a->expanded++;
+        DECISION_COUNT(expanded);
+
+        if (c.index == dest)
+            break;
+
+        unsigned int weights = g.ptr[adj->node_to_cell[c.index]];
+
+        for (e = adj->offsets[c.index]; e < adj->offsets[c.index + 1]; e++)
+        {
+            unsigned char weight = (weights >> (adj->directions[e] * 8)) & 0xff;
+
+            if (weight == 255)
+                continue;
+
+            int neighbor = adj->targets[e];
+            int cost = r->distance + weight;
+            search_record* n = search_arena_get(a, neighbor);
+
+            if (n->settled || (n->distance != -1 && cost >= n->distance))
+                continue;
+
+            left = bidirectional_distance_left(g, a, neighbor, target, back_top);
+
+            if (left == -1 || cost + left > best)
+                continue;
+
+            n->distance = cost;
+            n->size = r->size + 1;
+            n->first_step = c.index == src ? (map_index)neighbor : r->first_step;
+
+            value v = {neighbor, cost};
+            priority_queue_push(a->queue, v);
+        }
+    }
+
+    return search_arena_get_path(g, a, target);
+}
+#endif
+
+void compute_distance_field(const graph g, search_arena* a, vec2 source)
+{
+    // Let the search run until the priority queue is empty: every reachable
+    // position ends up with its shortest distance from the source.
+    dijkstra(g, a, source, -1);
+}
+
+flood_fill* flood_fill_create(const adjacency* adj, int w, int h)
+{
+    // The sets are laid out as the bitboards: each row is a run of words, and bit x % 64
+    // of word x / 64 stands for column x. The unused bits at the end of the rows are
+    // always clear.
+    flood_fill* f = tracked_malloc(sizeof(flood_fill));
+    int bytes, i;
+
+    f->words = (w + 63) / 64;
+    f->last_word = w % 64 == 0 ? ~0ULL : (1ULL << (w % 64)) - 1;
+    f->w = w;
+    f->h = h;
+
+    bytes = h * f->words * sizeof(unsigned long long);
+
+    f->walkable = tracked_malloc(bytes);
+    f->open = tracked_malloc(bytes);
+    f->frontier = tracked_malloc(4 * bytes);
+    f->next = tracked_malloc(4 * bytes);
+
+    memset(f->walkable, 0, bytes);
+
+    for (i = 0; i < adj->node_count; i++)
+    {
+        vec2 p = adj->positions[i];
+
+        f->walkable[p.y * f->words + p.x / 64] |= 1ULL << (p.x % 64);
+    }
+
+    return f;
+}
+
+static bool flood_fill_grow(flood_fill* f, const unsigned long long* from, int from_rows[2],
+    unsigned long long* to, int to_rows[2])
+{
+    // Put in the rows of `to` every open position one step away from a position of
+    // `from`, across the borders of the map when needed, and close them. The rows of
+    // a set that may not be empty are kept in a band, first row then last row: only
+    // the rows around the band of `from` need to be looked at, and only the band of
+    // `to` needs to be cleared from what it held before.
+    int y, k, first, last_row;
+    int last = f->words - 1;
+    int last_column = (f->w - 1) % 64; // The bit of the last column, in the last word of a row
+
+    for (y = to_rows[0]; y <= to_rows[1]; y++)
+        memset(to + y * f->words, 0, f->words * sizeof(unsigned long long));
+
+    // A band touching the border of the map grows on the other side too.
+    if (from_rows[0] == 0 || from_rows[1] == f->h - 1)
+    {
+        first = 0;
+        last_row = f->h - 1;
+    }
+    else
+    {
+        first = from_rows[0] - 1;
+        last_row = from_rows[1] + 1;
+    }
+
+    to_rows[0] = f->h;
+    to_rows[1] = -1;
+
+    for (y = first; y <= last_row; y++)
+    {
+        const unsigned long long* row = from + y * f->words;
+        const unsigned long long* below = from + (y == f->h - 1 ? 0 : y + 1) * f->words;
+        const unsigned long long* above = from + (y == 0 ? f->h - 1 : y - 1) * f->words;
+        unsigned long long* open = f->open + y * f->words;
+        unsigned long long* out = to + y * f->words;
+        unsigned long long any = 0;
+
+        for (k = 0; k < f->words; k++)
+        {
+            // Going north from the row below, and south from the row above...
+            unsigned long long d = below[k] | above[k];
+
+            // ...east from the column on the left, the first column being on the right of
+            // the last one through the border...
+            d |= row[k] << 1 | (k > 0 ? row[k - 1] >> 63 : (row[last] >> last_column) & 1);
+
+            // ...and west from the column on the right, and the other way round.
+            d |= row[k] >> 1 | (k < last ? row[k + 1] << 63 : (row[0] & 1) << last_column);
+
+            // The bits past the last column are never open.
+            out[k] = d & open[k];
+            open[k] &= ~out[k];
+            any |= out[k];
+        }
+
+        if (any != 0)
+        {
+            if (y < to_rows[0])
+                to_rows[0] = y;
+            to_rows[1] = y;
+        }
+    }
+
+    return to_rows[0] <= to_rows[1];
+}
+
+void flood_fill_search(const graph g, search_arena* a, vec2 source)
+{
+    // A breadth-first search where each layer is a handful of word operations per row:
+    //      next[dir] = dilate(frontier[dir]) & open
+    //      open = open & ~next[dir]
+    // The open positions are the ones Pacman can walk on and that were not reached yet.
+    // Closing the positions of a direction as soon as they are found means that a
+    // position reached through several first moves in the same layer keeps the first
+    // of them, in the order of the directions.
+
+    const adjacency* adj = &g.adj;
+    flood_fill* f = g.flood;
+
+    int size = f->h * f->words; // The number of words in a set of rows
+    int src = graph_get_node(g, source);
+    int first_steps[4]; // first_steps[dir] = the node of the first move towards dir
+    bool alive[4] = {false}; // alive[dir] = whether the layer of dir is not empty
+    int rows[2][4][2]; // The bands of rows of the layers, current then next, for each dir
+    int (*frontier_rows)[2] = rows[0];
+    int (*next_rows)[2] = rows[1];
+    int dir, e, k, x, y, layer;
+
+    search_record* r;
+
+    search_arena_begin(a);
+
+    if (src == -1) // Nothing can be reached from a wall.
+        return;
+
+    r = search_arena_get(a, src);
+    r->distance = 0;
+    r->size = 0;
+    r->first_step = src;
+    r->settled = true;
+    a->expanded++;
+    DECISION_COUNT(expanded);
+
+    memcpy(f->open, f->walkable, size * sizeof(unsigned long long));
+    memset(f->frontier, 0, 4 * size * sizeof(unsigned long long));
+    memset(f->next, 0, 4 * size * sizeof(unsigned long long));
+
+    for (dir = 0; dir < 4; dir++)
+    {
+        frontier_rows[dir][0] = next_rows[dir][0] = f->h;
+        frontier_rows[dir][1] = next_rows[dir][1] = -1;
+    }
+
+    f->open[source.y * f->words + source.x / 64] &= ~(1ULL << (source.x % 64));
+
+    // The first layer is made of the neighbors of the source, each being its own first move.
+    for (e = adj->offsets[src]; e < adj->offsets[src + 1]; e++)
+    {
+        vec2 p = adj->positions[adj->targets[e]];
+        unsigned long long bit = 1ULL << (p.x % 64);
+        int word = p.y * f->words + p.x / 64;
+
+        dir = adj->directions[e];
+
+        if (f->open[word] & bit) // The source may be its own neighbor on tiny maps
+        {
+            first_steps[dir] = adj->targets[e];
+            f->frontier[dir * size + word] |= bit;
+            f->open[word] &= ~bit;
+            frontier_rows[dir][0] = frontier_rows[dir][1] = p.y;
+            alive[dir] = true;
+        }
+    }
+
+    for (layer = 1; alive[NORTH] || alive[EAST] || alive[SOUTH] || alive[WEST]; layer++)
+    {
+        // Record the positions of the layer.
+        for (dir = 0; dir < 4; dir++)
+        {
+            const unsigned long long* frontier = f->frontier + dir * size;
+
+            for (y = frontier_rows[dir][0]; alive[dir] && y <= frontier_rows[dir][1]; y++)
+            {
+                for (k = 0; k < f->words; k++)
+                {
+                    unsigned long long word = frontier[y * f->words + k];
+
+                    while (word != 0)
+                    {
+                        x = k * 64 + bitboard_lowest_bit(word);
+                        word &= word - 1; // Clear the lowest bit set
+
+                        r = search_arena_get(a, adj->cell_to_node[y * f->w + x]);
+                        r->distance = layer;
+                        r->size = layer;
+                        r->first_step = first_steps[dir];
+                        r->settled = true;
+                        a->expanded++;
+                        DECISION_COUNT(expanded);
+                    }
+                }
+            }
+        }
+
+        // Grow the next layer from this one, the directions that died out staying empty.
+        for (dir = 0; dir < 4; dir++)
+        {
+            if (alive[dir])
+                alive[dir] = flood_fill_grow(f, f->frontier + dir * size, frontier_rows[dir], f->next + dir * size, next_rows[dir]);
+        }
+
+        // The next layer becomes the current one.
+        {
+            unsigned long long* spare = f->frontier;
+            int (*spare_rows)[2] = frontier_rows;
+
+            f->frontier = f->next;
+            f->next = spare;
+            frontier_rows = next_rows;
+            next_rows = spare_rows;
+        }
+    }
+}
+
+void flood_fill_destroy(flood_fill* f)
+{
+    // Release the resources held by the flood fill.
+    tracked_free(f->walkable);
+    tracked_free(f->open);
+    tracked_free(f->frontier);
+    tracked_free(f->next);
+
+    tracked_free(f);
+}
+
+void dispose_graph(graph g)
+{
+    // Release the resources held by the graph.
+    tracked_free(g.ptr);
+    tracked_free(g.rows);
+    flood_fill_destroy(g.flood);
+    dispose_adjacency(g.adj);
+
+#if PATHFINDING_IMPL == PATHFINDING_JUNCTION_GRAPH
+    dispose_junction_graph(g.junctions);
+#endif
+}
+
+#if PATHFINDING_IMPL == PATHFINDING_JUNCTION_GRAPH
+
+static unsigned char corridor_content(char entity)
+{
+    if (entity == VIRGIN_PATH)
+        return CORRIDOR_PELLET;
+
+    return entity == PATH ? CORRIDOR_PATH : CORRIDOR_OCCUPANT;
+}
+
+junction_graph* create_junction_graph(const adjacency* adj)
+{
+    // Every node that does not have exactly two neighbors is a junction. The corridors
+    // are found by walking from each junction along each of its edges until another
+    // junction is met.
+    junction_graph* j = tracked_malloc(sizeof(junction_graph));
+
+    int n = adj->node_count;
+    int edge_count = adj->offsets[n];
+    int node_count = 0; // The inner nodes of the corridors found so far
+    int sum_count = 0;
+    int next = 0; // The next junction to walk from
+    int loose = 0; // The next node that may belong to a loop without any junction
+
+    int i, e, f;
+
+    bool* walked = tracked_malloc(edge_count * sizeof(bool)); // The edges already walked along
+
+    j->junction_to_node = tracked_malloc(n * sizeof(int));
+    j->node_to_junction = tracked_malloc(n * sizeof(int));
+    j->node_corridor = tracked_malloc(n * sizeof(int));
+    j->node_position = tracked_malloc(n * sizeof(int));
+    j->nodes = tracked_malloc(n * sizeof(int));
+    j->contents = tracked_malloc(n);
+
+    // Every corridor starts with a different edge and ends with another one.
+    j->corridors = tracked_malloc((edge_count / 2 + 1) * sizeof(corridor));
+    j->corridor_count = 0;
+    j->junction_count = 0;
+
+    memset(walked, 0, edge_count * sizeof(bool));
+
+    for (i = 0; i < n; i++)
+    {
+        j->node_corridor[i] = -1;
+        j->node_position[i] = 0;
+
+        if (adj->offsets[i + 1] - adj->offsets[i] != 2)
+        {
+            j->node_to_junction[i] = j->junction_count;
+            j->junction_to_node[j->junction_count++] = i;
+        }
+        else
+        {
+            j->node_to_junction[i] = -1;
+        }
+    }
+
+    for (;;)
+    {
+        while (next < j->junction_count)
+        {
+            int start = j->junction_to_node[next];
+
+            for (e = adj->offsets[start]; e < adj->offsets[start + 1]; e++)
+            {
+                corridor* c;
+                int id, node, dir;
+
+                if (walked[e]) // Already walked along from its other end
+                    continue;
+
+                walked[e] = true;
+
+                id = j->corridor_count++;
+                c = &j->corridors[id];
+                c->from = next;
+                c->first = node_count;
+                c->length = 1;
+
+                dir = adj->directions[e];
+                node = adj->targets[e];
+
+                while (j->node_to_junction[node] == -1)
+                {
+                    j->node_corridor[node] = id;
+                    j->node_position[node] = c->length;
+                    j->nodes[node_count++] = node;
+
+                    // Leave the node by the edge that does not lead back.
+                    for (f = adj->offsets[node]; adj->directions[f] == (dir + 2) % 4; f++);
+
+                    dir = adj->directions[f];
+                    node = adj->targets[f];
+                    c->length++;
+                }
+
+                c->to = j->node_to_junction[node];
+                c->sums = sum_count;
+                sum_count += c->length + 1;
+
+                // The corridor must not be walked again from this end.
+                for (f = adj->offsets[node]; adj->directions[f] != (dir + 2) % 4; f++);
+                walked[f] = true;
+            }
+
+            next++;
+        }
+
+        // What is left are loops without any junction: one of their nodes
+        // becomes a junction to break them.
+        while (loose < n && (j->node_to_junction[loose] != -1 || j->node_corridor[loose] != -1))
+            loose++;
+
+        if (loose == n)
+            break;
+
+        j->node_to_junction[loose] = j->junction_count;
+        j->junction_to_node[j->junction_count++] = loose;
+    }
+
+    tracked_free(walked);
+
+    j->costs = tracked_malloc(sum_count * sizeof(int));
+    j->blocked = tracked_malloc(sum_count * sizeof(int));
+
+    // List the corridors ending at each junction, loops being listed from both ends.
+    j->incidence_offsets = tracked_malloc((j->junction_count + 1) * sizeof(int));
+    j->incidences = tracked_malloc(2 * j->corridor_count * sizeof(int));
+
+    memset(j->incidence_offsets, 0, (j->junction_count + 1) * sizeof(int));
+
+    for (i = 0; i < j->corridor_count; i++)
+    {
+        j->incidence_offsets[j->corridors[i].from + 1]++;
+        j->incidence_offsets[j->corridors[i].to + 1]++;
+    }
+
+    for (i = 0; i < j->junction_count; i++)
+        j->incidence_offsets[i + 1] += j->incidence_offsets[i];
+
+    for (i = 0; i < j->corridor_count; i++)
+    {
+        // The offsets of the first junctions are moved forward while filling, and then
+        // moved back below.
+        j->incidences[j->incidence_offsets[j->corridors[i].from]++] = 2 * i;
+        j->incidences[j->incidence_offsets[j->corridors[i].to]++] = 2 * i + 1;
+    }
+
+    for (i = j->junction_count; i > 0; i--)
+        j->incidence_offsets[i] = j->incidence_offsets[i - 1];
+
+    j->incidence_offsets[0] = 0;
+
+    j->source_node = -1;
+    j->source_junction = -1;
+
+    return j;
+}
+
+int corridor_node(const junction_graph* j, const corridor* c, int pos)
+{
+    if (pos == 0)
+        return j->junction_to_node[c->from];
+
+    if (pos == c->length)
+        return j->junction_to_node[c->to];
+
+    return j->nodes[c->first + pos - 1];
+}
+
+static unsigned char junction_graph_weight(const graph g, const junction_graph* j, int node)
+{
+    // The weight to enter a node is the same from all of its neighbors: the weight of
+    // its entity.
+    vec2 p = g.adj.positions[node];
+
+    return j->table[(unsigned char)g.map[p.y][p.x]];
 }
 
-value list_iterator_get(list_iterator it)
+static void corridor_sum(const graph g, junction_graph* j, corridor* c)
 {
-    // Dereference the iterator to get the underlying value.
-    // One must check if the iterator points to a valid node
-    // before calling this function.
-    return (*it.ptr)->v;
+    // Gather the weights along the corridor, counting what it holds on the way if it
+    // was not counted yet.
+    const int* nodes = j->nodes + c->first - 1; // nodes[k] is position k, inside the corridor
+    int* costs = j->costs + c->sums;
+    int* blocked = j->blocked + c->sums;
+    unsigned char weight;
+    bool count = !c->counted;
+    int k;
+
+    if (count)
+    {
+        c->pellets = 0;
+        c->occupants = 0;
+    }
+
+    weight = junction_graph_weight(g, j, j->junction_to_node[c->from]);
+    costs[0] = weight == 255 ? 0 : weight;
+    blocked[0] = weight == 255;
+
+    for (k = 1; k < c->length; k++)
+    {
+        vec2 p = g.adj.positions[nodes[k]];
+        char entity = g.map[p.y][p.x];
+
+        if (count)
+        {
+            j->contents[nodes[k]] = corridor_content(entity);
+            c->pellets += j->contents[nodes[k]] == CORRIDOR_PELLET;
+            c->occupants += j->contents[nodes[k]] == CORRIDOR_OCCUPANT;
+        }
+
+        weight = j->table[(unsigned char)entity];
+        costs[k] = costs[k - 1] + (weight == 255 ? 0 : weight);
+        blocked[k] = blocked[k - 1] + (weight == 255);
+    }
+
+    weight = junction_graph_weight(g, j, j->junction_to_node[c->to]);
+    costs[k] = costs[k - 1] + (weight == 255 ? 0 : weight);
+    blocked[k] = blocked[k - 1] + (weight == 255);
+
+    c->counted = true;
+    c->summed = true;
 }
 
-// **********************************************************************************
-// Priority queue functions implementation
-// **********************************************************************************
+int corridor_cost(const graph g, junction_graph* j, corridor* c, int from, int to)
+{
+    // Going forward enters the positions from + 1 to `to`, going backward enters
+    // the positions `to` to from - 1: both are differences of the sums.
+    const int* costs = j->costs + c->sums;
+    const int* blocked = j->blocked + c->sums;
 
-priority_queue* priority_queue_new(int(*cmp)(value, value))
+    if (!c->summed)
+    {
+        // The whole of a corridor holding only paths and Pacgums costs their weights
+        // times their counts, and the weight of the junction at the other end.
+        if (c->counted && c->occupants == 0 && from + to == c->length && (from == 0 || to == 0))
+        {
+            unsigned char end = junction_graph_weight(g, j, corridor_node(j, c, to));
+            unsigned char pellet = j->table[(unsigned char)VIRGIN_PATH];
+            unsigned char path = j->table[(unsigned char)PATH];
+            int paths = c->length - 1 - c->pellets;
+
+            if (end == 255 || (c->pellets > 0 && pellet == 255) || (paths > 0 && path == 255))
+                return -1;
+
+            return end + c->pellets * pellet + paths * path;
+        }
+
+        corridor_sum(g, j, c);
+    }
+
+    if (from <= to)
+    {
+        if (blocked[to] != blocked[from])
+            return -1;
+
+        return costs[to] - costs[from];
+    }
+    else
+    {
+        int cost_before = to > 0 ? costs[to - 1] : 0;
+        int blocked_before = to > 0 ? blocked[to - 1] : 0;
+
+        if (blocked[from - 1] != blocked_before)
+            return -1;
+
+        return costs[from - 1] - cost_before;
+    }
+}
+
+void junction_graph_update(junction_graph* j, int node, char entity)
 {
-    // Build a priority queue on top of a linked list.
-    priority_queue* q = malloc(sizeof(priority_queue));
-    q->l = list_new();
-    
-    // The order of elements will be determined by the comparator.
-    q->cmp_func = cmp;
-    
-    return q;
+    unsigned char content = corridor_content(entity);
+    corridor* c;
+    int i;
+
+    if (j->node_corridor[node] == -1)
+    {
+        // A junction weighs on every corridor ending at it.
+        int junction = j->node_to_junction[node];
+
+        for (i = j->incidence_offsets[junction]; i < j->incidence_offsets[junction + 1]; i++)
+            j->corridors[j->incidences[i] / 2].summed = false;
+
+        return;
+    }
+
+    c = &j->corridors[j->node_corridor[node]];
+    c->summed = false;
+
+    if (!c->counted) // Counted from the map when next walked along
+        return;
+
+    c->pellets += (content == CORRIDOR_PELLET) - (j->contents[node] == CORRIDOR_PELLET);
+    c->occupants += (content == CORRIDOR_OCCUPANT) - (j->contents[node] == CORRIDOR_OCCUPANT);
+    j->contents[node] = content;
 }
 
-void priority_queue_delete(priority_queue* q)
+void junction_graph_reset(junction_graph* j)
 {
-    // To properly delete the priority queue, we must
-    // delete the underlying list too.
-    list_delete(q->l);
-    
-    free(q);
+    int i;
+
+    for (i = 0; i < j->corridor_count; i++)
+    {
+        j->corridors[i].counted = false;
+        j->corridors[i].summed = false;
+    }
 }
 
-int priority_queue_size(priority_queue* q)
+static void junction_graph_relax(search_arena* a, int junction, int distance, int size, int first_step)
 {
-    // The priority queue size is the underlying list size.
-    return list_size(q->l);
+    search_record* r = search_arena_get(a, junction);
+
+    if (!r->settled && (r->distance == -1 || distance < r->distance))
+    {
+        r->distance = distance;
+        r->size = size;
+        r->first_step = first_step;
+
+        value v = {junction, distance};
+        priority_queue_push(a->queue, v);
+    }
 }
 
-void priority_queue_push(priority_queue* q, value v)
+void junction_graph_search(const graph g, search_arena* a, vec2 source)
 {
-    // Iterate through the list until we find the right place
-    // to insert the element. This shall be determined by the
-    // comparator function saved by the priority queue during
-    // its creation.
-    list_iterator it = list_iterator_begin(q->l);
-    
-    // While we are not at the end of the list, and the elements
-    // in the priority queue have lower priority than us
-    // (lowest priority means first), go to the next node.
-    while (!list_iterator_end(it) 
-        && q->cmp_func(list_iterator_get(it), v) < 0)
+    // The same Dijkstra's algorithm as over the whole adjacency, but from junction
+    // to junction. The records hold the first node to go to, as they do for the
+    // whole adjacency.
+    junction_graph* j = g.junctions;
+    priority_queue* q = a->queue;
+
+    int i, src = graph_get_node(g, source);
+
+    search_arena_begin(a);
+
+    j->source_node = src;
+    j->source_junction = -1;
+
+    if (src == -1) // Nothing can be reached from a wall.
+        return;
+
+    if (j->node_to_junction[src] != -1)
+    {
+        // The first step from the source depends on the corridor taken.
+        j->source_junction = j->node_to_junction[src];
+        junction_graph_relax(a, j->source_junction, 0, 0, src);
+    }
+    else
+    {
+        // Inside a corridor, the source can only go towards either end.
+        corridor* c = &j->corridors[j->node_corridor[src]];
+        int pos = j->node_position[src];
+        int cost;
+
+        if ((cost = corridor_cost(g, j, c, pos, 0)) != -1)
+            junction_graph_relax(a, c->from, cost, pos, corridor_node(j, c, pos - 1));
+
+        if ((cost = corridor_cost(g, j, c, pos, c->length)) != -1)
+            junction_graph_relax(a, c->to, cost, c->length - pos, corridor_node(j, c, pos + 1));
+    }
+
+    while (priority_queue_size(q) > 0)
+    {
+        value top;
+        search_record* r;
+
+        priority_queue_top(q, &top);
+        priority_queue_pop(q);
+
+        r = search_arena_get(a, top.index);
+
+        if (r->settled)
+            continue;
+
+        r->settled = true;
+        a->expanded++;
+        DECISION_COUNT(expanded);
+
+        for (i = j->incidence_offsets[top.index]; i < j->incidence_offsets[top.index + 1]; i++)
+        {
+            corridor* c = &j->corridors[j->incidences[i] / 2];
+            bool backward = j->incidences[i] % 2;
+
+            // Walk the whole corridor from the end this junction is at.
+            int from = backward ? c->length : 0;
+            int to = backward ? 0 : c->length;
+            int cost = corridor_cost(g, j, c, from, to);
+
+            if (cost == -1)
+                continue;
+
+            junction_graph_relax(a, backward ? c->from : c->to, r->distance + cost, r->size + c->length,
+                top.index == j->source_junction ? corridor_node(j, c, backward ? from - 1 : 1) : (int)r->first_step);
+        }
+    }
+}
+
+path_result junction_graph_get_path(const graph g, search_arena* a, vec2 target)
+{
+    // A junction holds its path in its record. The path to a position inside a corridor
+    // comes through either end of the corridor, or straight from the source if it lies
+    // in the same corridor.
+    junction_graph* j = g.junctions;
+
+    path_result res = {target, -1, -1};
+    int node = graph_get_node(g, target);
+    int side;
+
+    if (node == -1 || j->source_node == -1)
+        return res;
+
+    if (node == j->source_node)
+    {
+        res.distance = 0;
+        res.size = 0;
+        return res;
+    }
+
+    if (j->node_to_junction[node] != -1)
+    {
+        search_record* r = search_arena_get(a, j->node_to_junction[node]);
+
+        res.next_move = g.adj.positions[r->first_step];
+        res.distance = r->distance;
+        res.size = r->size;
+        return res;
+    }
+
+    corridor* c = &j->corridors[j->node_corridor[node]];
+    int pos = j->node_position[node];
+
+    for (side = 0; side < 2; side++)
+    {
+        int end = side ? c->to : c->from;
+        int end_pos = side ? c->length : 0;
+        search_record* r = search_arena_get(a, end);
+        int cost = corridor_cost(g, j, c, end_pos, pos);
+
+        if (r->distance == -1 || cost == -1)
+            continue;
+
+        if (res.distance == -1 || r->distance + cost < res.distance)
+        {
+            int first_step = end == j->source_junction
+                ? corridor_node(j, c, side ? end_pos - 1 : 1)
+                : (int)r->first_step;
+
+            res.next_move = g.adj.positions[first_step];
+            res.distance = r->distance + cost;
+            res.size = r->size + (side ? c->length - pos : pos);
+        }
+    }
+
+    if (j->node_corridor[j->source_node] == j->node_corridor[node])
+    {
+        int source_pos = j->node_position[j->source_node];
+        int cost = corridor_cost(g, j, c, source_pos, pos);
+
+        if (cost != -1 && (res.distance == -1 || cost < res.distance))
+        {
+            res.next_move = g.adj.positions[corridor_node(j, c, source_pos < pos ? source_pos + 1 : source_pos - 1)];
+            res.distance = cost;
+            res.size = source_pos < pos ? pos - source_pos : source_pos - pos;
+        }
+    }
+
+    return res;
+}
+
+void dispose_junction_graph(junction_graph* j)
+{
+    // Release the resources held by the junction graph.
+    tracked_free(j->junction_to_node);
+    tracked_free(j->node_to_junction);
+    tracked_free(j->node_corridor);
+    tracked_free(j->node_position);
+    tracked_free(j->corridors);
+    tracked_free(j->nodes);
+    tracked_free(j->incidence_offsets);
+    tracked_free(j->incidences);
+    tracked_free(j->costs);
+    tracked_free(j->blocked);
+    tracked_free(j->contents);
+
+    tracked_free(j);
+}
+
+#elif PATHFINDING_IMPL == PATHFINDING_DISTANCE_TABLE
+
+// The table of the current level, kept across the calls to `pacman`.
+static distance_table* distance_table_cache = NULL;
+
+// Forget the table of the previous level.
+static void distance_table_release(void)
+{
+    distance_table* t = distance_table_cache;
+
+    if (t == NULL)
+        return;
+
+    tracked_free(t->walls);
+    tracked_free(t->distances);
+    tracked_free(t);
+
+    distance_table_cache = NULL;
+}
+
+// The share of the table filled by one thread: the rows of every `stride`-th node,
+// starting from `first`.
+typedef struct
+{
+    const adjacency* adj;
+    map_index* distances;
+    int* queue; // The queue of the breadth-first searches, one node per slot
+    int first;
+    int stride;
+} distance_table_share;
+
+static void* distance_table_fill(void* arg)
+{
+    // A breadth-first search from each node of the share gives the number of steps
+    // to every other node.
+    const distance_table_share* s = arg;
+    const adjacency* adj = s->adj;
+
+    int n = adj->node_count;
+    int source, e;
+
+    for (source = s->first; source < n; source += s->stride)
+    {
+        map_index* row = s->distances + (size_t)source * n;
+        int head = 0, tail = 0;
+
+        memset(row, 0xff, n * sizeof(map_index));
+
+        row[source] = 0;
+        s->queue[tail++] = source;
+
+        while (head < tail)
+        {
+            int node = s->queue[head++];
+
+            for (e = adj->offsets[node]; e < adj->offsets[node + 1]; e++)
+            {
+                int neighbor = adj->targets[e];
+
+                if (row[neighbor] == DISTANCE_TABLE_UNREACHABLE)
+                {
+                    row[neighbor] = row[node] + 1;
+                    s->queue[tail++] = neighbor;
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+const distance_table* distance_table_acquire(const adjacency* adj, int w, int h)
+{
+    // The level is recognized by its walls: a hash to tell levels apart quickly, and
+    // the walls themselves to be sure.
+    distance_table* t;
+    distance_table_share shares[DISTANCE_TABLE_MAX_THREADS];
+    pthread_t threads[DISTANCE_TABLE_MAX_THREADS];
+
+    unsigned int hash = 2166136261u;
+    int i, thread_count, started;
+    char* walls;
+
+    // A map of another size is another level, whose table is not kept if it is too large.
+    if (distance_table_cache != NULL && (distance_table_cache->w != w || distance_table_cache->h != h))
+        distance_table_release();
+
+    if (adj->node_count > DISTANCE_TABLE_MAX_NODES)
+        return NULL;
+
+    t = distance_table_cache;
+
+    walls = tracked_malloc(w * h);
+
+    for (i = 0; i < w * h; i++)
+    {
+        walls[i] = adj->cell_to_node[i] == -1;
+        hash = (hash ^ (unsigned char)walls[i]) * 16777619u;
+    }
+
+    hash = ((hash ^ (unsigned int)w) * 16777619u ^ (unsigned int)h) * 16777619u;
+
+    if (t != NULL && t->hash == hash && t->w == w && t->h == h && memcmp(t->walls, walls, w * h) == 0)
+    {
+        tracked_free(walls);
+        return t;
+    }
+
+    // This is a new level: the table of the previous one is of no use anymore.
+    distance_table_release();
+
+    t = tracked_malloc(sizeof(distance_table));
+    t->hash = hash;
+    t->walls = walls;
+    t->w = w;
+    t->h = h;
+    t->node_count = adj->node_count;
+    t->distances = tracked_malloc((size_t)t->node_count * t->node_count * sizeof(map_index));
+
+    // Every row is independent from the others: the rows are shared between as many
+    // threads as there are processors.
+    thread_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (thread_count > DISTANCE_TABLE_MAX_THREADS)
+        thread_count = DISTANCE_TABLE_MAX_THREADS;
+
+    if (thread_count > t->node_count)
+        thread_count = t->node_count;
+
+    if (thread_count < 1)
+        thread_count = 1;
+
+    // The queues are allocated here, the allocation counters not being thread-safe.
+    for (i = 0; i < thread_count; i++)
+    {
+        shares[i].adj = adj;
+        shares[i].distances = t->distances;
+        shares[i].queue = tracked_malloc((t->node_count + 1) * sizeof(int));
+        shares[i].first = i;
+        shares[i].stride = thread_count;
+    }
+
+    // The calling thread takes the first share. If a thread cannot be started, the
+    // calling thread takes its share too.
+    for (started = 1; started < thread_count; started++)
+    {
+        if (pthread_create(&threads[started], NULL, distance_table_fill, &shares[started]) != 0)
+            break;
+    }
+
+    distance_table_fill(&shares[0]);
+
+    for (i = started; i < thread_count; i++)
+        distance_table_fill(&shares[i]);
+
+    for (i = 1; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    for (i = 0; i < thread_count; i++)
+        tracked_free(shares[i].queue);
+
+    distance_table_cache = t;
+
+    return t;
+}
+
+int distance_table_get(const distance_table* t, int from, int to)
+{
+    map_index d = t->distances[(size_t)from * t->node_count + to];
+
+    return d == DISTANCE_TABLE_UNREACHABLE ? -1 : d;
+}
+
+static bool distance_table_search(const graph g, search_arena* a, int source, int target, path_result* res)
+{
+    // An A* search towards the target: the number of steps left, read from the table,
+    // never exceeds the weighted distance left as no weight is below 1. The nodes are
+    // then settled in the same way as the Dijkstra's algorithm does.
+    const adjacency* adj = &g.adj;
+    priority_queue* q = a->queue;
+    search_record* r;
+
+    int e, expanded = 0;
+
+    search_arena_begin(a);
+
+    r = search_arena_get(a, source);
+    r->distance = 0;
+    r->size = 0;
+
+    value orig = {source, distance_table_get(g.table, source, target)};
+    priority_queue_push(q, orig);
+
+    while (priority_queue_size(q) > 0)
+    {
+        value c;
+        priority_queue_top(q, &c);
+        priority_queue_pop(q);
+
+        r = search_arena_get(a, c.index);
+
+        if (r->settled)
+            continue;
+
+        r->settled = true;
+        a->expanded++;
+        DECISION_COUNT(expanded);
+
+        if (c.index == target)
+        {
+            res->next_move = adj->positions[r->first_step];
+            res->distance = r->distance;
+            res->size = r->size;
+            return true;
+        }
+
+        if (++expanded > DISTANCE_TABLE_SEARCH_BUDGET)
+            return false;
+
+        unsigned int weights = g.ptr[adj->node_to_cell[c.index]];
+
+        for (e = adj->offsets[c.index]; e < adj->offsets[c.index + 1]; e++)
+        {
+            unsigned char weight = (weights >> (adj->directions[e] * 8)) & 0xff;
+            int neighbor = adj->targets[e];
+            int left = distance_table_get(g.table, neighbor, target);
+
+            if (weight == 255 || left == -1)
+                continue;
+
+            search_record* n = search_arena_get(a, neighbor);
+            int cost = r->distance + weight;
+
+            if (!n->settled && (n->distance == -1 || cost < n->distance))
+            {
+                n->distance = cost;
+                n->size = r->size + 1;
+                n->first_step = c.index == source ? (map_index)neighbor : r->first_step;
+
+                value v = {neighbor, cost + left};
+                priority_queue_push(q, v);
+            }
+        }
+    }
+
+    // The target cannot be reached past the entities that cannot be crossed.
+    return true;
+}
+
+bool distance_table_get_path(const graph g, search_arena* a, int source, vec2 target, const int* penalties, int penalty_count, path_result* res)
+{
+    // Every position costs at least 1 to enter, so no path is cheaper than its number of
+    // steps. If no position costing more than 1 lies on any of the shortest paths of the
+    // table, these paths are the cheapest ones: only the weight of the target is to be
+    // accounted for.
+    const distance_table* t = g.table;
+
+    int node = graph_get_node(g, target);
+    int steps, i, e;
+    unsigned char weight;
+
+    res->next_move = target;
+    res->distance = -1;
+    res->size = -1;
+
+    if (node == -1 || source == -1)
+        return true;
+
+    if (node == source)
+    {
+        res->distance = 0;
+        res->size = 0;
+        return true;
+    }
+
+    steps = distance_table_get(t, source, node);
+    weight = graph_get_node_weight(g, node);
+
+    if (steps == -1 || weight == 255)
+        return true;
+
+    for (i = 0; i < penalty_count; i++)
+    {
+        int before = distance_table_get(t, source, penalties[i]);
+        int after = distance_table_get(t, penalties[i], node);
+
+        if (penalties[i] != node && before != -1 && after != -1 && before + after == steps)
+            return distance_table_search(g, a, source, node, res);
+    }
+
+    // Any neighbor one step closer to the target is on a shortest path.
+    for (e = g.adj.offsets[source]; e < g.adj.offsets[source + 1]; e++)
     {
-        it = list_iterator_next(it);
+        if (distance_table_get(t, g.adj.targets[e], node) == steps - 1)
+        {
+            res->next_move = g.adj.positions[g.adj.targets[e]];
+            break;
+        }
     }
-    
-    // We have arrived at the right place, insert the new element
-    // here. The priority queue remains sorted.
-    list_insert(it, v);
-}
 
-int priority_queue_pop(priority_queue* q)
-{
-    // Remove the first element in the priority queue, i.e. the one
-    // with the lowest priority. If none, just silently fail.
-    if (priority_queue_size(q) == 0)
-        return 0;
-    
-    return list_remove(q->l, 0);
-}
+    res->distance = steps - 1 + weight;
+    res->size = steps;
 
-int priority_queue_top(priority_queue* q, value* v)
-{
-    // Pass the first element in the priority queue, i.e. the one
-    // with the lowest priority by address to the caller.
-    //If none, signal that we could not extract any element.
-    
-    if (priority_queue_size(q) == 0)
-        return 0;
-    
-    // Get the first element.
-    *v = list_iterator_get(list_iterator_begin(q->l));
-    
-    return 1; // A valid value has been put in *v
+    return true;
 }
 
+#endif
+
 // **********************************************************************************
-// Pathfinding functions implementation
+// Change tracking functions implementation
 // **********************************************************************************
 
-void graph_set_weight(graph g, int idx, direction dir, unsigned char weight)
+map_tracker* map_tracker_create(int w, int h)
 {
-    // The int type in C language is at least 4 bytes long on most machines, 
-    // meaning we could interpret an int as a contiguous array of at least 4 bytes.
-    
-    // The weight value is coded as a char (1 byte long), so we can store 4 weight values
-    // in an int. As we have 4 directions to handle in our game, this is perfect.
-    // One might wonder about endianness when treating ints that way, but since we only
-    // manipulate bytes individually, this is needless worry.
-    
-    // g.ptr[idx] = |    0xff    |    0xff    |    0xff    |    0xff    |
-    //              | WEST weight|SOUTH weight| EAST weight|NORTH weight|
-    
-    g.ptr[idx] &= ~(0xff << (dir * 8)); // Clean up the old value...
-    g.ptr[idx] |= (weight << (dir * 8)); // ...before putting the new one.
-}
+    // The tracker is allocated in the same fashion as the graph: the snapshot
+    // holds one character per graph position, and at most every position changes.
+    map_tracker* t = tracked_malloc(sizeof(map_tracker));
 
-unsigned char graph_get_weight(const graph g, int idx, direction dir)
-{
-    // In the same way, we access weights for a specific direction by bitshifting.
-    return (g.ptr[idx] >> (dir * 8)) & 0xff;
-}
+    t->snapshot = tracked_malloc(w * h);
+    t->changes = tracked_malloc(w * h * sizeof(int));
+    t->changed = tracked_malloc(w * h * sizeof(bool));
+    t->change_count = 0;
+    t->valid = false;
+    t->w = w;
+    t->h = h;
 
-vec2 create_vec2(int x, int y)
-{
-    // This function places x in the x field of vec2, and y in its y field
-    // (order sensitive). This is useful as the version of C used does not support
-    // brace initialisation directly passed as a parameter to a function.
-    vec2 p = {x, y};
-    return p;
-}
+    memset(t->changed, 0, w * h * sizeof(bool));
 
-vec2 wrap_coordinates(int w, int h, vec2 p)
-{
-    // Be cautious we never go out of the map, and mirror the
-    // coordinate that overflows accordingly.
-    vec2 n = p;
-    
-    if (n.y < 0)
-        n.y += h;
-    if (n.y >= h)
-        n.y -= h;
-    if (n.x < 0)
-        n.x += w;
-    if (n.x >= w)
-        n.x -= w;
-    
-    return n;
+    return t;
 }
 
-vec2 graph_index_to_coords(int idx, int w)
+void map_tracker_mark(map_tracker* t, int idx)
 {
-    // This function converts the indexing system used by the graph
-    // to the 2-dimensional system used by the game.
-    vec2 r = {idx % w, idx / w};
-    return r;
+    // A position is listed only once, however many reasons it has to change.
+    if (!t->changed[idx])
+    {
+        t->changed[idx] = true;
+        t->changes[t->change_count] = idx;
+        t->change_count++;
+    }
 }
 
-unsigned int coords_to_graph_index(vec2 pos, int w)
+void map_tracker_diff(map_tracker* t, char** map)
 {
-    // This function coverts the 2-dimensional coordinate system used
-    // by the game to the indexing system used by the graph.
-    return pos.y * w + pos.x;
-}
+    int x, y;
 
-unsigned int graph_get_neighbor_index(int w, int h, int src, direction dir)
-{
-    // Get the graph index of the neighbor of src in the given direction.
-    // This is easily done by converting the graph index to the game coordinates...
-    vec2 p = graph_index_to_coords(src, w);
-    
-    // We change the coordinates accordingly.
-    switch (dir)
+    for (y = 0; y < t->h; y++)
     {
-        case NORTH:
-            p.y--;
-            break;
-        case EAST:
-            p.x++;
-            break;
-        case SOUTH:
-            p.y++;
-            break;
-        case WEST:
-            p.x--;
-            break;
+        char* old_row = t->snapshot + y * t->w;
+        char* new_row = map[y];
+
+        // Most rows do not change between two calls: memcmp skips them at the
+        // speed of the vector instructions of the C library.
+        if (memcmp(old_row, new_row, t->w) == 0)
+            continue;
+
+        // Otherwise, compare the row 8 characters at a time, and only look at the
+        // characters one by one in the words that differ.
+        for (x = 0; x < t->w; x += 8)
+        {
+            int n = t->w - x < 8 ? t->w - x : 8;
+            int k;
+            unsigned long long a = 0, b = 0;
+
+            memcpy(&a, old_row + x, n);
+            memcpy(&b, new_row + x, n);
+
+            if (a == b)
+                continue;
+
+            for (k = 0; k < n; k++)
+            {
+                if (old_row[x + k] != new_row[x + k])
+                    map_tracker_mark(t, y * t->w + x + k);
+            }
+        }
+
+        // The snapshot now matches the map for this row.
+        memcpy(old_row, new_row, t->w);
     }
-    
-    // ...and then reverting back to the graph indexing system, without forgetting
-    // to mirror the coordinates if they ever overflowed.
-    return coords_to_graph_index(wrap_coordinates(w, h, p), w);
 }
 
-unsigned char get_weight_for_entity(char c, entities_weights config)
+void map_tracker_sync(map_tracker* t, graph g, entities_weights config)
 {
-    // This function essentially associate a game entity with its weight,
-    // following what we wanted to set for each entity.
-    unsigned char w;
-    
-    if (c == VIRGIN_PATH)
-    {
-        w = config.unexplored;
-    }
-    else if (c == PATH)
-    {
-        w = config.explored;
-    }
-    else if (c == ENERGY)
+    int i, dir;
+
+    if (!t->valid)
     {
-        w = config.energizer;
+        // Nothing to compare against yet: build the whole graph.
+        update_graph(g, config);
+
+        for (i = 0; i < t->h; i++)
+            memcpy(t->snapshot + i * t->w, g.map[i], t->w);
+
+        t->weights = config;
+        t->valid = true;
+
+        return;
     }
-    else if (c == GHOST1
-        || c == GHOST2
-        || c == GHOST3
-        || c == GHOST4)
+
+    // The positions whose entity changed on the map are already pending, from the diff
+    // made when the engine was acquired; add the positions whose entity did not change,
+    // but now weighs differently.
+    if (memcmp(&t->weights, &config, sizeof(entities_weights)) != 0)
     {
-        // The ghosts have all the same weight.
-        w = config.ghost;
+        bool reweighted[256];
+
+        // Tell, for every character, if its weight changed with the new configuration.
+        for (i = 0; i < 256; i++)
+            reweighted[i] = get_weight_for_entity((char)i, t->weights) != get_weight_for_entity((char)i, config);
+
+        for (i = 0; i < t->w * t->h; i++)
+        {
+            if (reweighted[(unsigned char)t->snapshot[i]])
+                map_tracker_mark(t, i);
+        }
+
+        t->weights = config;
     }
-    else
+
+#if PATHFINDING_IMPL == PATHFINDING_JUNCTION_GRAPH
+    build_weight_table(config, g.junctions->table);
+#endif
+
+    // The weight of a position is the cost of going to it from its neighbors: only the
+    // neighbors of a changed position need an update, in the direction facing it.
+    for (i = 0; i < t->change_count; i++)
     {
-        // Walls and the Door are impossible to pass through.
-        w = 255;
+        int idx = t->changes[i];
+        unsigned char weight = get_weight_for_entity(t->snapshot[idx], config);
+
+        for (dir = 0; dir < 4; dir++)
+        {
+            // The opposite of a direction is two quarter turns away.
+            graph_set_weight(g, graph_get_neighbor_index(g.w, g.h, idx, dir), (dir + 2) % 4, weight);
+        }
+
+#if PATHFINDING_IMPL == PATHFINDING_JUNCTION_GRAPH
+        // The corridors holding the position count its new entity and weigh it again.
+        if (g.adj.cell_to_node[idx] != -1)
+            junction_graph_update(g.junctions, g.adj.cell_to_node[idx], t->snapshot[idx]);
+#endif
     }
-    
-    return w;
+
+    // The changes are applied: forget them.
+    for (i = 0; i < t->change_count; i++)
+        t->changed[t->changes[i]] = false;
+
+    t->change_count = 0;
 }
 
-void compute_weights(char** map, int w, int h, int x, int y, char* weights, entities_weights config)
+bool map_tracker_walls_changed(const map_tracker* t, const graph g)
 {
-    // Compute the weight to go between the x-y position provided and all its neighbors.
-    // A neighbor to a extreme position is the mirror in the right direction.
-    
-    vec2 neighbors[] = {
-        wrap_coordinates(w, h, create_vec2(x, y - 1)),
-        wrap_coordinates(w, h, create_vec2(x + 1, y)),
-        wrap_coordinates(w, h, create_vec2(x, y + 1)),
-        wrap_coordinates(w, h, create_vec2(x - 1, y))
-    };
+    // The walls and the Door are the positions without a node in the adjacency.
+    int i;
 
-    int dir;
-    
-    // For each direction, get the weight to go to the neighbor in that direction.
-    for (dir = 0; dir < 4; dir++)
+    for (i = 0; i < t->change_count; i++)
     {
-        weights[dir] = get_weight_for_entity(map[neighbors[dir].y][neighbors[dir].x], config);
+        int idx = t->changes[i];
+        bool blocked = t->snapshot[idx] == WALL || t->snapshot[idx] == DOOR;
+
+        if (blocked != (g.adj.cell_to_node[idx] == -1))
+            return true;
     }
+
+    return false;
 }
 
-graph create_graph(char** map, int width, int height)
+void map_tracker_destroy(map_tracker* t)
 {
-    // Create a reusable graph structure, much more easily modifiable 
-    // than the map itself.
-    // Each element in the graph will match a unique position on the map.
-    // This is assured by the existence and unicity of the Euclidean division:
-    //      - graph_idx = y * width + x
-    //      - {x = graph_idx % width, y = graph_idx / width}
-    graph g;
-    
-    g.ptr = malloc(width * height * sizeof(unsigned int));
-    g.map = map;
-    g.w = width;
-    g.h = height;
-    
-    memset(g.ptr, 0, width * height * sizeof(unsigned int));
-        
-    return g;
+    // Release the resources held by the tracker.
+    tracked_free(t->snapshot);
+    tracked_free(t->changes);
+    tracked_free(t->changed);
+
+    tracked_free(t);
 }
 
-void update_graph(graph g, entities_weights config)
+void dispose_findings(findings f)
 {
-    // Populate the provided graph, using the procedures defined
-    // above.
-    
-    int i, j, dir;
+    // Release the resources held by findings.
+    if (f.count > 0)
+        tracked_free(f.positions);
+}
+
+// ***********************************************************************************
+// Bitboard functions implementation
+// ***********************************************************************************
+
+int bitboard_popcount(unsigned long long word)
+{
+    // A single instruction on most machines.
+#ifdef __GNUC__
+    return __builtin_popcountll(word);
+#else
+    int count = 0;
 
-    for (i = 0; i < g.w; i++)
+    while (word != 0)
     {
-        for (j = 0; j < g.h; j++)
-        {
-            int idx = g.w * j + i; // This is the math explained above.
-            char weights[4];
-            
-            compute_weights(g.map, g.w, g.h, i, j, weights, config);
-            
-            for (dir = 0; dir < 4; dir++)
-                graph_set_weight(g, idx, dir, weights[dir]);
-        }
+        word &= word - 1;
+        count++;
     }
+
+    return count;
+#endif
 }
 
-int compare_weights(value left, value right)
+int bitboard_lowest_bit(unsigned long long word)
 {
-    // Compare the weight values to sort nodes in the priority queue.
-    return left.weight - right.weight;
+#ifdef __GNUC__
+    return __builtin_ctzll(word);
+#else
+    int x = 0;
+
+    while (!(word & 1))
+    {
+        word >>= 1;
+        x++;
+    }
+
+    return x;
+#endif
 }
 
-path_result shortest_path(const graph g, vec2 source, vec2 target)
+bitboard* bitboard_create(int w, int h)
 {
-    // An adapted implementation of the Dijkstra's algorithm.
-    
-    // Some aliases for less typing
-    int w = g.w;
-    int h = g.h;
-    
-    int i, dir; // Define some iterators
-    
-    int current; // The current graph node being analysed
-    
-    unsigned char* distances; // distance[k] = distance from source to k
-    bool* visited; // visited[k] is true if the algorithm already analysed it
-    unsigned int* predecessors; // predecessors[k] is the node explored before the current one
-    priority_queue* q; // The priority queue to extract the nodes to analyse from
-    
-    bool finished = false; // A flag signalling we should stop the Dijkstra's algorithm
-    bool found = false; // A flag signalling we found the target.
-    
-    unsigned int src; // The graph index of the source
-    unsigned int dest; // The graph index of the target
-    unsigned int pred; // The current predecessor, used when rebuilding the path from target to source
-    
-    int shortest_distance = -1; // The weighted distance between the source and the target (-1 means no path)
-    int real_path_size = -1; // The raw distance between the source and the target (-1 means no path)
-    vec2 next_target; // The position Pacman should go to for the next round
-    
-    // Those arrays are allocated in the same fashion as the graph.
-    distances = malloc(w * h);
-    visited = malloc(w * h);
-    predecessors = malloc(w * h * sizeof(unsigned int));
-    
-    // Fill those arrays with default values.
-    memset(distances, 0xff, w * h);
-    memset(predecessors, 0xff, w * h * sizeof(unsigned int));
-    memset(visited, 0, w * h);
-    
-    src = coords_to_graph_index(source, w);
-    dest = coords_to_graph_index(target, w);
-    
-    // The distance from the source to the source is 0.
-    distances[src] = 0;
-    
-    current = src;
-    
-    // Create the priority queue.
-    q = priority_queue_new(compare_weights);
-    
-    // Add the source element with a zero weight to the priority queue.
-    // This shall be our starting point.
-    value orig = {src, 0};
-    priority_queue_push(q, orig);
-    
-    while (!finished)
+    // A row takes as many words as needed for its columns, the last one being
+    // partly used: its unused bits are always clear.
+    bitboard* b = tracked_malloc(sizeof(bitboard));
+
+    b->words = (w + 63) / 64;
+    b->bits = tracked_malloc(BOARD_CLASS_COUNT * h * b->words * sizeof(unsigned long long));
+    b->column_starts = tracked_malloc((w + 1) * sizeof(int));
+    b->w = w;
+    b->h = h;
+
+    memset(b->bits, 0, BOARD_CLASS_COUNT * h * b->words * sizeof(unsigned long long));
+    memset(b->counts, 0, sizeof(b->counts));
+
+    // The characters of the game are only known at link time: their classes are looked
+    // up in a table rather than switched on.
+    memset(b->classes, BOARD_CLASS_COUNT, sizeof(b->classes));
+    b->classes[(unsigned char)WALL] = BOARD_WALL;
+    b->classes[(unsigned char)VIRGIN_PATH] = BOARD_PELLET;
+    b->classes[(unsigned char)ENERGY] = BOARD_ENERGIZER;
+    b->classes[(unsigned char)GHOST1] = BOARD_GHOST;
+    b->classes[(unsigned char)GHOST2] = BOARD_GHOST;
+    b->classes[(unsigned char)GHOST3] = BOARD_GHOST;
+    b->classes[(unsigned char)GHOST4] = BOARD_GHOST;
+    b->classes[(unsigned char)DOOR] = BOARD_DOOR;
+
+    return b;
+}
+
+void bitboard_build(bitboard* b, char** map)
+{
+    // Read the map in the order it is laid out in memory, row after row, and build the
+    // words of every class 64 columns at a time. The positions holding nothing of
+    // interest go to an extra word that is thrown away.
+    int x, y, i, c;
+
+    memset(b->counts, 0, sizeof(b->counts));
+
+    for (y = 0; y < b->h; y++)
     {
-        // Grab the topmost element in the priority queue, we will 
-        value c;
-        priority_queue_top(q, &c);
-        priority_queue_pop(q);
-        current = c.index;
-        
-        if (current == dest) // If we reached the destination...
-        {
-            // Signal it so we exit the loop.
-            finished = true;
-            found = true;
-        }
-        else
+        const char* row = map[y];
+
+        for (x = 0; x < b->w; x += 64)
         {
-            // Otherwise, let us visit every neighbor of this position.
-            for (dir = 0; dir < 4; dir++)
-            {
-                int neighbor = graph_get_neighbor_index(w, h, current, dir);
-                
-                if (!visited[neighbor]) // If we have not visited this neighbor yet...
-                {
-                    visited[neighbor] = true; // Mark it as visited
-                    
-                    unsigned char weight = graph_get_weight(g, current, dir);
-                    int cost = distances[current] + weight;
-                    
-                    // See if going to this neighbor is cheaper than before...
-                    if (cost < distances[neighbor])
-                    {
-                        distances[neighbor] = cost; // Set the new cost to go to this neighbor.
-                        predecessors[neighbor] = current; // Set the predecessor to build the path afterwards.
-                        
-                        // Add this neighbor to the queue to visit it later, and possibly build the shortest
-                        // path from it.
-                        value n = {neighbor, cost};
-                        priority_queue_push(q, n);
-                    }
-                }
-            }
+            unsigned long long words[BOARD_CLASS_COUNT + 1] = {0};
+            int n = b->w - x < 64 ? b->w - x : 64;
 
-            if (priority_queue_size(q) == 0) // If we emptied the priority queue without finishing...
+            for (i = 0; i < n; i++)
+                words[b->classes[(unsigned char)row[x + i]]] |= 1ULL << i;
+
+            for (c = 0; c < BOARD_CLASS_COUNT; c++)
             {
-                // We could not find a path between the source and the target.
-                finished = true;
-                found = false;
+                b->bits[(c * b->h + y) * b->words + x / 64] = words[c];
+                b->counts[c] += bitboard_popcount(words[c]);
             }
         }
     }
+}
+
+void bitboard_update(bitboard* b, int idx, char c)
+{
+    int x = idx % b->w, y = idx / b->w, cls;
+    board_class now = b->classes[(unsigned char)c];
+    unsigned long long bit = 1ULL << (x % 64);
 
-    if (found) // If a path was found...
+    for (cls = 0; cls < BOARD_CLASS_COUNT; cls++)
     {
-        shortest_distance = distances[dest]; // The weighted distance is stored here.
-        
-        pred = dest; // The starting point is the destination...
-        
-        i = 0; // This will give the raw size of the path.
-        while (pred != src) // ...and we iterate backwards until we meet the source.
+        unsigned long long* word = b->bits + (cls * b->h + y) * b->words + x / 64;
+
+        // What was eaten is only known once the ghost is gone.
+        if (now == BOARD_GHOST && (cls == BOARD_PELLET || cls == BOARD_ENERGIZER))
+            continue;
+
+        // The count only follows the bits that flip.
+        if (cls == (int)now && !(*word & bit))
         {
-            // Update the target each loop iteration, so in the end we keep the first
-            // item of the whole path, that is the position Pacman should head to.
-            next_target = graph_index_to_coords(pred, w);
-            pred = predecessors[pred];
-            
-            i++;
+            *word |= bit;
+            b->counts[cls]++;
+        }
+        else if (cls != (int)now && (*word & bit))
+        {
+            *word &= ~bit;
+            b->counts[cls]--;
         }
-        
-        real_path_size = i; // We store the raw size here to construct a path result.
     }
-    
-    // Those were allocated by dynamic allocation, don't forget to free them.
-    free(visited);
-    free(distances);
-    free(predecessors);
-    
-    // Release the resources held by the priority queue.
-    priority_queue_delete(q);
-    
-    // Build the path result...
-    path_result res = {next_target, shortest_distance, real_path_size};
-    
-    // ...then give our final answer.
-    return res;
 }
 
-void dispose_graph(graph g)
+const unsigned long long* bitboard_row(const bitboard* b, board_class c, int y)
 {
-    // Release the resources held by the graph.
-    free(g.ptr);
+    // The rows of a class are stored one after the other, as in the map.
+    return b->bits + (c * b->h + y) * b->words;
 }
 
-void find_ghosts(char** map, int w, int h, vec2* ghosts_pos)
+bool bitboard_test(const bitboard* b, board_class c, vec2 pos)
 {
-    int i, j; // Define some iterators.
-    
-    for (i = 0; i < w; i++)
+    return (bitboard_row(b, c, pos.y)[pos.x / 64] >> (pos.x % 64)) & 1;
+}
+
+int bitboard_count(const bitboard* b, board_class c)
+{
+    return b->counts[c];
+}
+
+unsigned char bitboard_neighbors(const bitboard* b, board_class c, vec2 pos)
+{
+    // A neighbor to a extreme position is the mirror in the right direction.
+    vec2 north = wrap_coordinates(b->w, b->h, create_vec2(pos.x, pos.y - 1));
+    vec2 east = wrap_coordinates(b->w, b->h, create_vec2(pos.x + 1, pos.y));
+    vec2 south = wrap_coordinates(b->w, b->h, create_vec2(pos.x, pos.y + 1));
+    vec2 west = wrap_coordinates(b->w, b->h, create_vec2(pos.x - 1, pos.y));
+
+    // Each bit tested is moved to the place of its direction in the mask.
+    return bitboard_test(b, c, north) << NORTH
+        | bitboard_test(b, c, east) << EAST
+        | bitboard_test(b, c, south) << SOUTH
+        | bitboard_test(b, c, west) << WEST;
+}
+
+void bitboard_extract(bitboard* b, board_class c, findings* out)
+{
+    // The positions are listed column by column, as the map used to be searched, so
+    // that the entities at the same distance from Pacman keep being chosen in the same
+    // order. The bits are found row by row though, skipping the empty words: a first
+    // pass counts the entities of each column, and a second one puts each entity in the
+    // next free place of its column, the rows being visited from top to bottom.
+    int pass, x, y, k;
+
+    out->count = bitboard_count(b, c);
+    out->positions = NULL;
+
+    if (out->count == 0)
+        return;
+
+    out->positions = tracked_malloc(out->count * sizeof(vec2));
+    memset(b->column_starts, 0, (b->w + 1) * sizeof(int));
+
+    for (pass = 0; pass < 2; pass++)
     {
-        for (j = 0; j < h; j++)
+        for (y = 0; y < b->h; y++)
         {
-            // Look for the ghosts on the map and report their
-            // position to the caller.
-            if (map[j][i] == GHOST1)
-            {
-                ghosts_pos[0] = create_vec2(i, j);
-            }
-            else if (map[j][i] == GHOST2)
-            {
-                ghosts_pos[1] = create_vec2(i, j);
-            }
-            else if (map[j][i] == GHOST3)
+            const unsigned long long* row = bitboard_row(b, c, y);
+
+            for (k = 0; k < b->words; k++)
             {
-                ghosts_pos[2] = create_vec2(i, j);
+                unsigned long long word = row[k];
+
+                while (word != 0)
+                {
+                    x = k * 64 + bitboard_lowest_bit(word);
+                    word &= word - 1; // Clear the lowest bit set
+
+                    if (pass == 0)
+                        b->column_starts[x + 1]++;
+                    else
+                        out->positions[b->column_starts[x]++] = create_vec2(x, y);
+                }
             }
-            else if (map[j][i] == GHOST4)
+        }
+
+        // Once counted, the columns start after all the ones before them.
+        for (x = 0; pass == 0 && x < b->w; x++)
+            b->column_starts[x + 1] += b->column_starts[x];
+    }
+}
+
+void bitboard_destroy(bitboard* b)
+{
+    // Release the resources held by the bitboard.
+    tracked_free(b->bits);
+    tracked_free(b->column_starts);
+
+    tracked_free(b);
+}
+
+// ***********************************************************************************
+// Threat field functions implementation
+// ***********************************************************************************
+
+threat_field* threat_field_create(int w, int h)
+{
+    // One value of each kind per graph position, as for the graph.
+    threat_field* t = tracked_malloc(sizeof(threat_field));
+
+    t->time = tracked_malloc(w * h * sizeof(int));
+    t->nearest = tracked_malloc(w * h * sizeof(int));
+    t->sources = tracked_malloc(w * h * sizeof(int));
+    t->source_count = 0;
+    t->queue = tracked_malloc(w * h * sizeof(int));
+    t->seen = tracked_malloc(w * h * sizeof(unsigned int));
+    t->w = w;
+    t->h = h;
+
+    // Stamp 0 is never used by a count, so zeroed positions are all unseen.
+    memset(t->seen, 0, w * h * sizeof(unsigned int));
+    t->stamp = 0;
+
+    return t;
+}
+
+void threat_field_compute(threat_field* t, char** map, const vec2* ghosts, int ghost_count, int horizon)
+{
+    // All the ghosts are queued at once: the positions are then reached in the order of
+    // their distance to the nearest ghost, which is the one they are reached from. The
+    // nearest ghost of a position is only written once the position is reached.
+    int head = 0, tail = 0;
+    int i, dir;
+
+    memset(t->time, 0xff, t->w * t->h * sizeof(int));
+    t->source_count = 0;
+
+    for (i = 0; i < ghost_count; i++)
+    {
+        vec2 p = ghosts[i];
+        int idx;
+
+        // Ghosts that could not be found do not threaten anything.
+        if (p.x < 0 || p.x >= t->w || p.y < 0 || p.y >= t->h || map[p.y][p.x] == WALL)
+            continue;
+
+        idx = coords_to_graph_index(p, t->w);
+
+        if (t->time[idx] != -1)
+            continue;
+
+        t->time[idx] = 0;
+        t->nearest[idx] = i;
+        t->sources[t->source_count++] = idx;
+        t->queue[tail++] = idx;
+    }
+
+    // The neighbors of a position are found from its coordinates, mirrored across the
+    // borders, rather than through graph_get_neighbor_index, which would divide by the
+    // width twice per neighbor.
+    while (head < tail)
+    {
+        int idx = t->queue[head++];
+        int x = idx % t->w, y = idx / t->w;
+        vec2 neighbors[4];
+
+        if (t->time[idx] == horizon)
+            continue;
+
+        neighbors[NORTH] = create_vec2(x, y > 0 ? y - 1 : t->h - 1);
+        neighbors[EAST] = create_vec2(x < t->w - 1 ? x + 1 : 0, y);
+        neighbors[SOUTH] = create_vec2(x, y < t->h - 1 ? y + 1 : 0);
+        neighbors[WEST] = create_vec2(x > 0 ? x - 1 : t->w - 1, y);
+
+        for (dir = 0; dir < 4; dir++)
+        {
+            vec2 p = neighbors[dir];
+            int neighbor = p.y * t->w + p.x;
+
+            if (t->time[neighbor] == -1 && map[p.y][p.x] != WALL)
             {
-                ghosts_pos[3] = create_vec2(i, j);
+                t->time[neighbor] = t->time[idx] + 1;
+                t->nearest[neighbor] = t->nearest[idx];
+                t->queue[tail++] = neighbor;
             }
         }
     }
 }
 
-void find_entities(char** map, int w, int h, char entity, int estimated_number, findings* out)
+int threat_field_time(const threat_field* t, vec2 pos)
 {
-    int i, j; // Define some iterators.
-    int nb_entities, entities_old_count; // We need to keep hold of how much entities there is.
-    
-    nb_entities = 0;
-    // We begin by an estimated number of entities, provided by the caller, as a starting point.
-    entities_old_count = estimated_number;
-    out->positions = malloc(entities_old_count * sizeof(vec2));
-    
-    for (i = 0; i < w; i++)
+    return t->time[coords_to_graph_index(pos, t->w)];
+}
+
+int threat_field_nearest(const threat_field* t, vec2 pos)
+{
+    int idx = coords_to_graph_index(pos, t->w);
+
+    return t->time[idx] == -1 ? -1 : t->nearest[idx];
+}
+
+int threat_field_count_near(threat_field* t, char** map, vec2 pos, int radius)
+{
+    // Mostly, not even the nearest ghost is near.
+    int idx = coords_to_graph_index(pos, t->w);
+    int head = 0, tail = 0, count = 0;
+    int depth, dir;
+
+    if (t->time[idx] == -1 || t->time[idx] > radius)
+        return 0;
+
+    // Otherwise, the ghosts are the positions reached at time 0, and the steps between a
+    // ghost and the position are the same both ways: a search bounded by the radius around
+    // the position meets every ghost near it.
+    t->stamp++;
+
+    // After four billion counts the stamps wrap around: clear the positions for real so
+    // that an old stamp cannot be mistaken for the current one.
+    if (t->stamp == 0)
+    {
+        memset(t->seen, 0, t->w * t->h * sizeof(unsigned int));
+        t->stamp = 1;
+    }
+
+    t->seen[idx] = t->stamp;
+    t->queue[tail++] = idx;
+
+    for (depth = 0; depth <= radius; depth++)
     {
-        for (j = 0; j < h; j++)
+        int end = tail;
+
+        while (head < end)
         {
-            if (map[j][i] == entity)
+            idx = t->queue[head++];
+            count += t->time[idx] == 0;
+
+            for (dir = 0; dir < 4 && depth < radius; dir++)
             {
-                // As we find entities, we need to increase the array size if the total number of
-                // said entity exceeds the old array size.
-                if (nb_entities == entities_old_count)
+                int neighbor = graph_get_neighbor_index(t->w, t->h, idx, dir);
+                vec2 n = graph_index_to_coords(neighbor, t->w);
+
+                if (t->seen[neighbor] != t->stamp && map[n.y][n.x] != WALL)
                 {
-                    // We double the array size each time we hit the limit, so we don't hit it
-                    // too often.
-                    entities_old_count *= 2;
-                    out->positions = realloc(out->positions, entities_old_count * sizeof(vec2));
+                    t->seen[neighbor] = t->stamp;
+                    t->queue[tail++] = neighbor;
                 }
-                
-                // Add this entity to the list.
-                out->positions[nb_entities] = create_vec2(i, j);
-                nb_entities++;
             }
         }
     }
-    
-    // A final realloc here to adjust the array size to the actual number of entities.
-    out->positions = realloc(out->positions, nb_entities * sizeof(vec2));
-    out->count = nb_entities;
+
+    return count;
 }
 
-void dispose_findings(findings f)
+void threat_field_destroy(threat_field* t)
 {
-    // Release the resources held by findings.
-    if (f.count > 0)
-        free(f.positions);
+    // Release the resources held by the threat field.
+    tracked_free(t->time);
+    tracked_free(t->nearest);
+    tracked_free(t->sources);
+    tracked_free(t->queue);
+    tracked_free(t->seen);
+
+    tracked_free(t);
 }
 
 // ***********************************************************************************
@@ -1266,9 +5327,13 @@ ai_engine* ai_engine_create(char** map, int x, int y, int w, int h)
     // The engine is not ready after its creation; it needs to be properly
     // initialised by ai_engine_initialise().
     
-    ai_engine* ctx = malloc(sizeof(ai_engine));
+    ai_engine* ctx = tracked_malloc(sizeof(ai_engine));
     
     ctx->g = create_graph(map, w, h);
+    ctx->tracker = map_tracker_create(w, h);
+    ctx->arena = search_arena_create(w, h);
+    ctx->threats = threat_field_create(w, h);
+    ctx->board = bitboard_create(w, h);
     ctx->pacman = create_vec2(x, y);
     
     ctx->weights.explored = 1;
@@ -1290,38 +5355,89 @@ ai_engine* ai_engine_create(char** map, int x, int y, int w, int h)
     return ctx;
 }
 
+// The engine kept across the calls of the pacman function, in the persistent mode.
+static ai_engine* persistent_engine = NULL;
+
+ai_engine* ai_engine_acquire(char** map, int x, int y, int w, int h, direction lastdirection)
+{
+    ai_engine* ctx = persistent_engine;
+    
+    // A new game, or a map of another size, cannot be compared with the previous move.
+    if (ctx != NULL && (lastdirection == -1 || ctx->g.w != w || ctx->g.h != h || !ctx->tracker->valid))
+    {
+        ai_engine_destroy(ctx);
+        ctx = NULL;
+    }
+    
+    if (ctx != NULL)
+    {
+        // The positions that changed since the previous move are pending until the
+        // graph is synchronised: looking through them is enough to tell if the level
+        // changed, without hashing the whole map.
+        ctx->g.map = map;
+        map_tracker_diff(ctx->tracker, map);
+        
+        if (map_tracker_walls_changed(ctx->tracker, ctx->g))
+        {
+            ai_engine_destroy(ctx);
+            ctx = NULL;
+        }
+    }
+    
+    if (ctx == NULL)
+        ctx = ai_engine_create(map, x, y, w, h);
+    
+    // Everything else depends on the move.
+    ctx->pacman = create_vec2(x, y);
+    ctx->decision = -1;
+    
+    persistent_engine = ctx;
+    
+    return ctx;
+}
+
 void ai_engine_initialise(ai_engine* ctx)
 {
     // The AI engine initialisation finds all needed entities and
     // allocate the proper number of path results.
     // Basically, the AI engine is ready after initialisation.
+    int i;
     
-    vec2 pos_ghosts[4];
-    find_ghosts(ctx->g.map, ctx->g.w, ctx->g.h, pos_ghosts);
-    ctx->ghosts.positions = malloc(4 * sizeof(vec2));
-    ctx->ghosts.count = 4;
-    
-    memcpy(ctx->ghosts.positions, pos_ghosts, 4 * sizeof(vec2));
-    
-    find_entities(ctx->g.map, ctx->g.w, ctx->g.h, ENERGY, 4, &ctx->energizers);
-    find_entities(ctx->g.map, ctx->g.w, ctx->g.h, VIRGIN_PATH, 600, &ctx->virgin_paths);
+    // A single pass over the map classifies all of its positions, unless the bitboard
+    // is kept from the previous move: then only the positions that changed since are...
+    if (ctx->tracker->valid)
+    {
+        for (i = 0; i < ctx->tracker->change_count; i++)
+        {
+            int idx = ctx->tracker->changes[i];
+            bitboard_update(ctx->board, idx, ctx->tracker->snapshot[idx]);
+        }
+    }
+    else
+    {
+        bitboard_build(ctx->board, ctx->g.map);
+    }
     
-    ctx->paths_to_ghosts = malloc(4 * sizeof(path_result));
+    // ...the ghosts being listed right away, however many were seen: one may be hidden
+    // behind another one, or behind Pacman. The energizers and Pacgums are only counted
+    // from the bitboard: their positions are listed by the searches that need them.
+    bitboard_extract(ctx->board, BOARD_GHOST, &ctx->ghosts);
     
-    if (ctx->energizers.count > 0)
-        ctx->paths_to_energizers = malloc(ctx->energizers.count * sizeof(path_result));
+    // How soon the ghosts can be near anywhere is known from now on.
+    threat_field_compute(ctx->threats, ctx->g.map, ctx->ghosts.positions, ctx->ghosts.count,
+        strategy.ghost_near_radius);
     
-    if (ctx->virgin_paths.count > 0)
-        ctx->paths_to_virgin_paths = malloc(ctx->virgin_paths.count * sizeof(path_result));
+    if (ctx->ghosts.count > 0)
+        ctx->paths_to_ghosts = tracked_malloc(ctx->ghosts.count * sizeof(path_result));
 }
 
 void ai_engine_target_nearest_ghost(ai_engine* ctx)
 {
     // Get the nearest ghost from Pacman. The paths to ghosts must have been computed beforehand.
-    int i = get_nearest_entity_index(ctx->paths_to_ghosts, 4);
+    int i = get_nearest_entity_index(ctx->paths_to_ghosts, ctx->ghosts.count);
     
     if (i != -1) // If we found one, make our decision to target it.
-        ctx->decision = orientation(ctx->pacman, ctx->paths_to_ghosts[i].next_move, ctx->g.w, ctx->g.h);
+        ctx->decision = orientation(ctx->g, ctx->pacman, ctx->paths_to_ghosts[i].next_move);
 }
 
 void ai_engine_target_nearest_energizer(ai_engine* ctx)
@@ -1330,7 +5446,7 @@ void ai_engine_target_nearest_energizer(ai_engine* ctx)
     int i = get_nearest_entity_index(ctx->paths_to_energizers, ctx->energizers.count);
     
     if (i != -1) // If we found one, make our decision to target it.
-        ctx->decision = orientation(ctx->pacman, ctx->paths_to_energizers[i].next_move, ctx->g.w, ctx->g.h);
+        ctx->decision = orientation(ctx->g, ctx->pacman, ctx->paths_to_energizers[i].next_move);
 }
 
 void ai_engine_target_nearest_unexplored_path(ai_engine* ctx)
@@ -1339,78 +5455,168 @@ void ai_engine_target_nearest_unexplored_path(ai_engine* ctx)
     int i = get_nearest_entity_index(ctx->paths_to_virgin_paths, ctx->virgin_paths.count);
     
     if (i != -1) // If we found one, make our decision to target it.
-        ctx->decision = orientation(ctx->pacman, ctx->paths_to_virgin_paths[i].next_move, ctx->g.w, ctx->g.h);
+        ctx->decision = orientation(ctx->g, ctx->pacman, ctx->paths_to_virgin_paths[i].next_move);
+}
+
+void ai_engine_update_graph(ai_engine* ctx)
+{
+    map_tracker* t = ctx->tracker;
+    int i, y, k;
+
+    DECISION_PHASE_BEGIN(PHASE_UPDATE_GRAPH);
+
+    // Until the graph is built once, the synchronisation builds it whole. Afterwards, the
+    // positions whose weight changes with the ghosts and the energizers are marked here,
+    // and the tracker is told of their new weights, so that it only looks through the
+    // map if another weight changed too.
+    if (t->valid && t->weights.ghost != ctx->weights.ghost)
+    {
+        for (i = 0; i < ctx->threats->source_count; i++)
+            map_tracker_mark(t, ctx->threats->sources[i]);
+
+        t->weights.ghost = ctx->weights.ghost;
+    }
+
+    if (t->valid && t->weights.energizer != ctx->weights.energizer)
+    {
+        // An energizer covered by a ghost is still in the bitboard: marking it is harmless,
+        // its weight is recomputed from the ghost.
+        for (y = 0; y < ctx->board->h; y++)
+        {
+            const unsigned long long* row = bitboard_row(ctx->board, BOARD_ENERGIZER, y);
+
+            for (k = 0; k < ctx->board->words; k++)
+            {
+                unsigned long long word = row[k];
+
+                while (word != 0)
+                {
+                    map_tracker_mark(t, y * ctx->board->w + k * 64 + bitboard_lowest_bit(word));
+                    word &= word - 1; // Clear the lowest bit set
+                }
+            }
+        }
+
+        t->weights.energizer = ctx->weights.energizer;
+    }
+
+    map_tracker_sync(t, ctx->g, ctx->weights);
+
+    DECISION_PHASE_END(PHASE_UPDATE_GRAPH);
 }
 
 void ai_engine_search_ghosts(ai_engine* ctx)
 {
     // Search the shortest paths between Pacman and every ghost while avoiding energizers.
     ctx->weights.ghost = 1;
-    ctx->weights.energizer = 50;
+    ctx->weights.energizer = strategy.chase_energizer_weight;
     
-    // We must update the graph, as we changed some weight values.
-    update_graph(ctx->g, ctx->weights);
+    // We must update the graph, as we changed some weight values. Only the positions
+    // holding entities whose weight changed are recomputed.
+    ai_engine_update_graph(ctx);
     
-    compute_shortest_paths(ctx->g, ctx->pacman, ctx->ghosts.positions, 4, ctx->paths_to_ghosts);
+    ai_engine_compute_paths(ctx, ctx->ghosts.positions, ctx->ghosts.count, ctx->paths_to_ghosts);
 }
 
 void ai_engine_search_energizers(ai_engine* ctx)
 {
     // Search the shortest paths between Pacman and every energizer while avoiding ghosts.
-    ctx->weights.ghost = 50;
+    ctx->weights.ghost = strategy.flee_ghost_weight;
     ctx->weights.energizer = 1;
     
-    // We must update the graph, as we changed some weight values.
-    update_graph(ctx->g, ctx->weights);
+    // We must update the graph, as we changed some weight values. Only the positions
+    // holding entities whose weight changed are recomputed.
+    ai_engine_update_graph(ctx);
+    
+    bitboard_extract(ctx->board, BOARD_ENERGIZER, &ctx->energizers);
+    
+    if (ctx->energizers.count > 0)
+        ctx->paths_to_energizers = tracked_malloc(ctx->energizers.count * sizeof(path_result));
     
-    compute_shortest_paths(ctx->g, ctx->pacman, ctx->energizers.positions, ctx->energizers.count, ctx->paths_to_energizers);
+    ai_engine_compute_paths(ctx, ctx->energizers.positions, ctx->energizers.count, ctx->paths_to_energizers);
 }
 
 void ai_engine_search_unexplored_paths(ai_engine* ctx, search_settings s)
 {
     // Search the shortest paths between Pacman and every Pacgum while avoiding other entities
     // according to what the user specified as flags.
-    ctx->weights.energizer = s & IGNORE_ENERGIZER ? 1 : 20;
-    ctx->weights.ghost = s & IGNORE_GHOST ? 1 : 50;
+    ctx->weights.energizer = s & IGNORE_ENERGIZER ? 1 : strategy.pellet_energizer_weight;
+    ctx->weights.ghost = s & IGNORE_GHOST ? 1 : strategy.pellet_ghost_weight;
     
-    // We must update the graph, as we changed some weight values.
-    update_graph(ctx->g, ctx->weights);
+    // We must update the graph, as we changed some weight values. Only the positions
+    // holding entities whose weight changed are recomputed.
+    ai_engine_update_graph(ctx);
     
-    compute_shortest_paths(ctx->g, ctx->pacman, ctx->virgin_paths.positions, ctx->virgin_paths.count, ctx->paths_to_virgin_paths);
+    bitboard_extract(ctx->board, BOARD_PELLET, &ctx->virgin_paths);
+    
+    if (ctx->virgin_paths.count > 0)
+        ctx->paths_to_virgin_paths = tracked_malloc(ctx->virgin_paths.count * sizeof(path_result));
+    
+    ai_engine_compute_paths(ctx, ctx->virgin_paths.positions, ctx->virgin_paths.count, ctx->paths_to_virgin_paths);
 }
 
-int ai_engine_get_number_ghosts_near(const ai_engine* ctx, int max_distance)
+int ai_engine_get_number_ghosts_near(const ai_engine* ctx)
 {
-    int cpt = 0; // How many ghosts are there near Pacman?
-    int i;
-    
-    for (i = 0; i < 4; i++)
-    {
-        // If the path exists and its raw size is less than the distance specified as limit...
-        if (ctx->paths_to_ghosts[i].size != -1 && ctx->paths_to_ghosts[i].size < max_distance)
-        {
-            // Count it as a ghost that is near.
-            cpt++;
-        }
-    }
-    
-    return cpt;
+    // How soon the ghosts can reach Pacman is known since the initialisation: no path to
+    // the ghosts is needed to tell how many of them are around it.
+    return threat_field_count_near(ctx->threats, ctx->g.map, ctx->pacman, strategy.ghost_near_radius);
 }
 
 int ai_engine_get_number_energizers_left(const ai_engine* ctx)
 {
-    // Return the number of energizers left on the map.
-    // Does not support entity overlap (if a ghost is covering an energizer, 
-    // it will not be seen).
-    return ctx->energizers.count;
+    // Return the number of energizers left on the map, counted from the bitboard.
+    // An energizer covered by a ghost is only remembered by a persistent engine
+    // that saw it before the ghost came.
+    return bitboard_count(ctx->board, BOARD_ENERGIZER);
 }
 
 int ai_engine_get_number_virgin_paths_left(const ai_engine* ctx)
 {
-    // Return the number of Pacgums left on the map.
-    // Does not support entity overlap (if a ghost is covering a Pacgum, 
-    // it will not be seen).
-    return ctx->virgin_paths.count;
+    // Return the number of Pacgums left on the map, counted from the bitboard.
+    // A Pacgum covered by a ghost is only remembered by a persistent engine
+    // that saw it before the ghost came.
+    return bitboard_count(ctx->board, BOARD_PELLET);
+}
+
+bool ai_engine_has_unit_weights(const ai_engine* ctx)
+{
+    // The paths are everywhere, but an energizer or a ghost only matters if there is one:
+    // the ghosts are the positions the threat field was started from.
+    return ctx->weights.unexplored == 1
+        && ctx->weights.explored == 1
+        && (ctx->weights.energizer == 1 || bitboard_count(ctx->board, BOARD_ENERGIZER) == 0)
+        && (ctx->weights.ghost == 1 || ctx->threats->source_count == 0);
+}
+
+void ai_engine_compute_paths(ai_engine* ctx, const vec2* positions, int position_count, path_result* results)
+{
+    int i;
+
+    if (position_count == 0) // Nothing to look for, spare the search.
+        return;
+
+    DECISION_PHASE_BEGIN(PHASE_SHORTEST_PATHS);
+
+    // A single target is better searched for on its own, and the distance table already
+    // knows the number of steps between any two positions.
+    if (position_count == 1 || PATHFINDING_IMPL == PATHFINDING_DISTANCE_TABLE || !ai_engine_has_unit_weights(ctx))
+    {
+        compute_shortest_paths(ctx->g, ctx->arena, ctx->pacman, positions, position_count, results);
+    }
+    else
+    {
+        // All the distances are numbers of steps: growing the layers of a breadth-first search
+        // 64 positions at a time gives the shortest path to every position on the map...
+        flood_fill_search(ctx->g, ctx->arena, ctx->pacman);
+
+        // ...so that each target only needs a lookup.
+        for (i = 0; i < position_count; i++)
+        {
+            results[i] = search_arena_get_path(ctx->g, ctx->arena, positions[i]);
+        }
+    }
+
+    DECISION_PHASE_END(PHASE_SHORTEST_PATHS);
 }
 
 direction ai_engine_get_next_move(const ai_engine* ctx)
@@ -1419,6 +5625,13 @@ direction ai_engine_get_next_move(const ai_engine* ctx)
     bool tested[4] = {false};
     bool stuck = false;
     
+    const adjacency* adj = &ctx->g.adj;
+    int src = graph_get_node(ctx->g, ctx->pacman);
+    
+    // The neighbors of Pacman holding a ghost or an energizer, one bit per direction.
+    unsigned char occupied = src == -1 ? 0
+        : bitboard_neighbors(ctx->board, BOARD_GHOST, ctx->pacman) | bitboard_neighbors(ctx->board, BOARD_ENERGIZER, ctx->pacman);
+    
     while (!stuck && d == -1) // Until we get a valid direction...
     {
         // Let us check if we have not already tried every direction...
@@ -1431,21 +5644,16 @@ direction ai_engine_get_next_move(const ai_engine* ctx)
         {
             // Generate a random direction.
             int dir = rand() % 4;
+            int e;
             
-            // Get the neighbor of Pacman in this direction.
-            vec2 neighbor = graph_index_to_coords(
-                graph_get_neighbor_index(
-                    ctx->g.w,
-                    ctx->g.h,
-                    coords_to_graph_index(ctx->pacman, ctx->g.w),
-                                         dir),
-                                         ctx->g.w);
-            
-            // If it is an accessible place, go for it.
-            if (ctx->g.map[neighbor.y][neighbor.x] == PATH 
-                || ctx->g.map[neighbor.y][neighbor.x] == VIRGIN_PATH)
+            // Get the neighbor of Pacman in this direction, if it is not a wall.
+            for (e = adj->offsets[src]; src != -1 && e < adj->offsets[src + 1]; e++)
             {
-                d = dir;
+                // If it is an accessible place, go for it.
+                if (adj->directions[e] == dir && !(occupied & (1 << dir)))
+                {
+                    d = dir;
+                }
             }
             
             // We tried this direction.
@@ -1456,26 +5664,49 @@ direction ai_engine_get_next_move(const ai_engine* ctx)
     return d; // This shall be the final answer of the AI engine.
 }
 
-void ai_engine_destroy(ai_engine* ctx)
+void ai_engine_end_turn(ai_engine* ctx)
 {
-    // As the AI engine dynamically allocated resources, it should
-    // release them as it no longer needs them.
-    // This shall be performed just after getting the final decision.
-    
-    free(ctx->paths_to_ghosts);
+    // The entities found during the move, and the paths to them, are
+    // only valid for this move.
     
+    if (ctx->ghosts.count > 0)
+        tracked_free(ctx->paths_to_ghosts);
     if (ctx->energizers.count > 0)
-        free(ctx->paths_to_energizers);
+        tracked_free(ctx->paths_to_energizers);
     if (ctx->virgin_paths.count > 0)
-        free(ctx->paths_to_virgin_paths);
+        tracked_free(ctx->paths_to_virgin_paths);
     
     dispose_findings(ctx->ghosts);
     dispose_findings(ctx->energizers);
     dispose_findings(ctx->virgin_paths);
     
+    ctx->ghosts.positions = NULL;
+    ctx->ghosts.count = 0;
+    ctx->energizers.positions = NULL;
+    ctx->energizers.count = 0;
+    ctx->virgin_paths.positions = NULL;
+    ctx->virgin_paths.count = 0;
+    
+    ctx->paths_to_ghosts = NULL;
+    ctx->paths_to_energizers = NULL;
+    ctx->paths_to_virgin_paths = NULL;
+}
+
+void ai_engine_destroy(ai_engine* ctx)
+{
+    // As the AI engine dynamically allocated resources, it should
+    // release them as it no longer needs them.
+    // This shall be performed just after getting the final decision.
+    
+    ai_engine_end_turn(ctx);
+    
     dispose_graph(ctx->g);
+    map_tracker_destroy(ctx->tracker);
+    search_arena_destroy(ctx->arena);
+    threat_field_destroy(ctx->threats);
+    bitboard_destroy(ctx->board);
     
-    free(ctx);
+    tracked_free(ctx);
 }
 
 int get_nearest_entity_index(const path_result* paths, int path_count)
@@ -1486,7 +5717,7 @@ int get_nearest_entity_index(const path_result* paths, int path_count)
     int i;
     
     int nearest_entity_index = -1; // Initialise as to say no entity was found
-    int nearest_entity_distance = 50000; // Initialise with a huge distance
+    map_distance nearest_entity_distance = INT_MAX; // Initialise with a distance no path reaches
     
     for (i = 0; i < path_count; i++)
     {
@@ -1502,41 +5733,124 @@ int get_nearest_entity_index(const path_result* paths, int path_count)
     return nearest_entity_index; // Return the index. One could access its actual distance later on.
 }
 
-void compute_shortest_paths(const graph g, vec2 pacman, const vec2* positions, int position_count, path_result* results)
+void compute_shortest_paths(const graph g, search_arena* a, vec2 pacman, const vec2* positions, int position_count, path_result* results)
 {
     // Compute the shortest paths from pacman to the positions specified. Path results are stored in the results
     // parameter, which must be a properly allocated array of size at least position_count elements.
-    
+
     int i;
-    
+
+    if (position_count == 0) // Nothing to look for, spare the search.
+        return;
+
+#if PATHFINDING_IMPL == PATHFINDING_JUNCTION_GRAPH
+    // One search over the junctions gives the shortest path to every junction...
+    junction_graph_search(g, a, pacman);
+
+    // ...from which the path to each target is derived through its corridor.
     for (i = 0; i < position_count; i++)
     {
-        results[i] = shortest_path(g, pacman, positions[i]);
+        results[i] = junction_graph_get_path(g, a, positions[i]);
     }
-}
+#elif PATHFINDING_IMPL == PATHFINDING_DISTANCE_TABLE
+    int penalties[DISTANCE_TABLE_MAX_PENALTIES];
+    int penalty_count = 0;
+    int source = graph_get_node(g, pacman);
+    bool field = g.table == NULL; // Whether the paths are read from a distance field
+
+    // List the positions costing more than 1 to enter. The table is of no help past
+    // a few of them, or if one costs nothing.
+    for (i = 0; !field && i < g.adj.node_count; i++)
+    {
+        unsigned char weight = graph_get_node_weight(g, i);
 
-direction orientation(vec2 pacman, vec2 target, int w, int h) 
-{
-    // Gives the actual direction for Pacman to take to go to the specified target.
-    // The target position must be adjacent to the position of Pacman.
-    direction d = -1;
+        if (i == source || weight == 1)
+            continue;
+
+        if (weight == 0 || penalty_count == DISTANCE_TABLE_MAX_PENALTIES)
+            field = true;
+        else
+            penalties[penalty_count++] = i;
+    }
+
+    if (field)
+        compute_distance_field(g, a, pacman);
 
-    if (pacman.x == target.x - 1 || (pacman.x == w - 1 && target.x == 0)) 
+    for (i = 0; i < position_count; i++)
     {
-        d = EAST;
+        // If a local search gives up, this path and the next ones are read from
+        // a distance field instead.
+        if (!field && !distance_table_get_path(g, a, source, positions[i], penalties, penalty_count, &results[i]))
+        {
+            field = true;
+            compute_distance_field(g, a, pacman);
+        }
+
+        if (field)
+            results[i] = search_arena_get_path(g, a, positions[i]);
     }
-    else if (pacman.x == target.x + 1 || (pacman.x == 0 && target.x == w - 1)) 
+#else
+    // A single target is better searched for on its own...
+    if (position_count == 1)
     {
-        d = WEST;
+        results[0] = shortest_path(g, a, pacman, positions[0]);
+        return;
     }
-    else if (pacman.y == target.y - 1 || (pacman.y == h - 1 && target.y == 0)) 
+
+    // ...but otherwise one search from Pacman gives the shortest path to every position on the map...
+    compute_distance_field(g, a, pacman);
+
+    // ...so that each target only needs a lookup.
+    for (i = 0; i < position_count; i++)
     {
-        d = SOUTH;
+        results[i] = search_arena_get_path(g, a, positions[i]);
     }
-    else if (pacman.y == target.y + 1 || (pacman.y == 0 && target.y == h - 1)) 
+#endif
+}
+
+direction orientation(const graph g, vec2 pacman, vec2 target)
+{
+    // Gives the actual direction for Pacman to take to go to the specified target.
+    // The target position must be adjacent to the position of Pacman: it is one of
+    // the neighbors listed in the adjacency, along with the direction leading to it.
+    direction d = -1;
+    int e;
+
+    int src = graph_get_node(g, pacman);
+    int dest = graph_get_node(g, target);
+
+    if (src == -1 || dest == -1)
+        return d;
+
+    for (e = g.adj.offsets[src]; e < g.adj.offsets[src + 1]; e++)
     {
-        d = NORTH;
+        if (g.adj.targets[e] == dest)
+            d = g.adj.directions[e];
     }
 
     return d;
 }
+
+direction fallback_move(char** map, int w, int h, int x, int y, direction lastdirection)
+{
+    // The neighbors are looked at in the last direction first, then clockwise. The
+    // coordinates are kept in int, as they may not fit a map_coord.
+    const int dx[4] = {0, 1, 0, -1}, dy[4] = {-1, 0, 1, 0};
+    direction free_move = -1;
+    int first = lastdirection >= NORTH && lastdirection <= WEST ? lastdirection : NORTH;
+    int i;
+
+    for (i = 0; i < 4; i++)
+    {
+        direction d = (first + i) % 4;
+        char c = map[(y + dy[d] + h) % h][(x + dx[d] + w) % w];
+
+        if (c == VIRGIN_PATH || c == ENERGY)
+            return d;
+
+        if (free_move == -1 && c != WALL && c != DOOR && c != GHOST1 && c != GHOST2 && c != GHOST3 && c != GHOST4)
+            free_move = d;
+    }
+
+    return free_move != -1 ? free_move : lastdirection;
+}
@@ -1,5 +1,4 @@
 #include "dijkstra.h"
-#include "priority_queue.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -27,8 +26,8 @@ const char* dir_name(int dir)
 
 void graph_set_weight(graph g, int idx, int dir, unsigned char weight)
 {
-    g.ptr[idx] &= ~(0xff << (dir * 8));
-    g.ptr[idx] |= (weight << (dir * 8));
+    g.ptr[idx] &= ~(0xffu << (dir * 8));
+    g.ptr[idx] |= ((unsigned int)weight << (dir * 8));
 }
 
 unsigned char graph_get_weight(graph g, int idx, int dir)
@@ -142,6 +141,11 @@ void compute_weights(char** map, int w, int h, int x, int y, char* weights, enti
     }
 }
 
+int compare_weights(value left, value right)
+{
+    return left.weight - right.weight;
+}
+
 graph generate_graph(char** map, int width, int height, entities_weights config)
 {
     graph g;
@@ -150,6 +154,7 @@ graph generate_graph(char** map, int width, int height, entities_weights config)
     g.map = map;
     g.w = width;
     g.h = height;
+    g.queue = priority_queue_new(compare_weights);
     
     memset(g.ptr, 0, width * height * sizeof(unsigned int));
     
@@ -184,85 +189,91 @@ void update_graph(graph g, entities_weights config)
     
 }
 
-int compare_weights(value left, value right)
+static int toroidal_distance(int w, int h, vec2 from, vec2 to)
 {
-    return left.weight - right.weight;
+    int dx = abs(from.x - to.x);
+    int dy = abs(from.y - to.y);
+    
+    if (w - dx < dx)
+        dx = w - dx;
+    if (h - dy < dy)
+        dy = h - dy;
+    
+    return dx + dy;
 }
 
-path_result distance_nearest_entity(graph g, vec2 source, vec2 target)
+static path_result search(graph g, vec2 source, vec2 target, bool guided)
 {
     int w = g.w;
     int h = g.h;
     
     int i, j, dir;
     
-    unsigned char* distances = malloc(w * h);
+    int* distances = malloc(w * h * sizeof(int));
     bool* visited = malloc(w * h);
     int* predecessors = malloc(w * h * sizeof(int));
-    bool finished = false;
     bool found = false;
+    int expanded = 0;
     
     int src = w * source.y + source.x;
     int dest = w * target.y + target.x;
     
-    memset(distances, 0xff, w * h);
+    memset(distances, 0xff, w * h * sizeof(int));
     memset(predecessors, 0xff, w * h * sizeof(int));
     memset(visited, 0, w * h);
     
     distances[src] = 0;
     
-    int current = src;
-    
-    priority_queue* q = priority_queue_new(compare_weights);
+    priority_queue* q = g.queue;
+    priority_queue_clear(q);
     
-    value orig = {src, 0};
+    value orig = {src, guided ? toroidal_distance(w, h, source, target) : 0};
     priority_queue_push(q, orig);
     
-    while (!finished)
+    while (priority_queue_size(q) > 0)
     {
         value c;
         priority_queue_top(q, &c);
         priority_queue_pop(q);
-        current = c.index;
+        
+        int current = c.index;
+        
+        if (visited[current])
+            continue;
+        
+        visited[current] = true;
+        expanded++;
         
         if (current == dest)
         {
             found = true;
-            finished = true;
+            break;
         }
-        else
+        
+        for (dir = 0; dir < 4; dir++)
         {
-            for (dir = 0; dir < 4; dir++)
+            int neighbor = graph_get_neighbor_index(w, h, current, dir);
+            unsigned char weight = graph_get_weight(g, current, dir);
+            
+            if (visited[neighbor] || weight == 255)
+                continue;
+            
+            int cost = distances[current] + weight;
+            
+            if (distances[neighbor] == -1 || cost < distances[neighbor])
             {
-                int neighbor = graph_get_neighbor_index(w, h, current, dir);
-                
-                if (!visited[neighbor])
-                {
-                    visited[neighbor] = true;
-                    
-                    unsigned char weight = graph_get_weight(g, current, dir);
-                    int cost = distances[current] + weight;
-                    
-                    if (cost < distances[neighbor])
-                    {
 #ifdef DEBUG
-                        printf("Found near neighbor for [%d,%d]: [%d,%d] (dir=%s) {cost=%d,weight=%d}\n",
-                            current % w, current / w, neighbor % w, neighbor / w, dir_name(dir), cost, weight
-                        );
+                printf("Found near neighbor for [%d,%d]: [%d,%d] (dir=%s) {cost=%d,weight=%d}\n",
+                    current % w, current / w, neighbor % w, neighbor / w, dir_name(dir), cost, weight
+                );
 #endif
-                        distances[neighbor] = cost;
-                        predecessors[neighbor] = current;
-                        
-                        value n = {neighbor, cost};
-                        priority_queue_push(q, n);
-                    }
-                }
-            }
-            
-            if (priority_queue_size(q) == 0)
-            {
-                finished = true;
-                found = false;
+                distances[neighbor] = cost;
+                predecessors[neighbor] = current;
+                
+                int estimate = guided ? toroidal_distance(w, h, graph_index_to_coords(neighbor, w), target) : 0;
+                
+                value n = {neighbor, cost + estimate};
+                priority_queue_push(q, n);
             }
         }
     }
@@ -310,13 +321,21 @@ path_result distance_nearest_entity(graph g, vec2 source, vec2 target)
     free(distances);
     free(predecessors);
     
-    priority_queue_delete(q);
-    
-    path_result res = {shortest_path, shortest_distance, path_size};
+    path_result res = {shortest_path, shortest_distance, path_size, expanded};
     
     return res;
 }
 
+path_result distance_nearest_entity(graph g, vec2 source, vec2 target)
+{
+    return search(g, source, target, false);
+}
+
+path_result astar_nearest_entity(graph g, vec2 source, vec2 target)
+{
+    return search(g, source, target, true);
+}
+
 void dispose_result(path_result p)
 {
     free(p.path);
@@ -325,4 +344,5 @@ void dispose_result(path_result p)
 void dispose_graph(graph g)
 {
     free(g.ptr);
+    priority_queue_delete(g.queue);
 }
@@ -1,6 +1,8 @@
 #ifndef DIJKSTRA_H
 #define DIJKSTRA_H
 
+#include "priority_queue.h"
+
 // Definition of the direction type, which relies on the enum type compass:
 enum compass {NORTH, EAST, SOUTH, WEST};
 
@@ -26,6 +28,7 @@ typedef struct
     vec2* path;
     int distance;
     int size;
+    int expanded;
 } path_result;
 
 typedef struct
@@ -34,12 +37,14 @@ typedef struct
     char** map;
     int w;
     int h;
+    priority_queue* queue;
 } graph;
 
 graph generate_graph(char** map, int w, int h, entities_weights weights);
 void update_graph(graph g, entities_weights config);
 
 path_result distance_nearest_entity(graph g, vec2 source, vec2 target);
+path_result astar_nearest_entity(graph g, vec2 source, vec2 target);
 
 void dispose_result(path_result p);
 void dispose_graph(graph g);
@@ -2,26 +2,66 @@
 
 #include <stdlib.h>
 
+node* node_pool_acquire(node_pool* p)
+{
+    if (p->free_nodes)
+    {
+        node* n = p->free_nodes;
+        p->free_nodes = n->next;
+        
+        return n;
+    }
+    
+    if (!p->slabs || p->used == NODE_POOL_SLAB_SIZE)
+    {
+        node_slab* slab = malloc(sizeof(node_slab));
+        if (!slab)
+            return NULL;
+        
+        slab->next = p->slabs;
+        p->slabs = slab;
+        p->used = 0;
+    }
+    
+    return &p->slabs->nodes[p->used++];
+}
+
+void node_pool_release(node_pool* p, node* n)
+{
+    n->next = p->free_nodes;
+    p->free_nodes = n;
+}
+
+void node_pool_release_all(node_pool* p)
+{
+    while (p->slabs)
+    {
+        node_slab* next = p->slabs->next;
+        free(p->slabs);
+        
+        p->slabs = next;
+    }
+    
+    p->used = 0;
+    p->free_nodes = NULL;
+}
+
 list* list_new()
 {
     list* l = malloc(sizeof(list));
     l->first = NULL;
     l->size = 0;
     
+    l->pool.slabs = NULL;
+    l->pool.used = 0;
+    l->pool.free_nodes = NULL;
+    
     return l;
 }
 
 void list_delete(list* l)
 {
-    node* current = l->first;
-    
-    while (current)
-    {
-        node* next = current->next;
-        free(current);
-        
-        current = next;
-    }
+    node_pool_release_all(&l->pool);
     
     free(l);
 }
@@ -53,7 +93,7 @@ int list_remove(list* l, int idx)
     if (idx == 0)
     {
         l->first = n->next;
-        free(n);
+        node_pool_release(&l->pool, n);
     }
     else
     {
@@ -65,7 +105,7 @@ int list_remove(list* l, int idx)
         node* rip = n->next;
         n->next = rip->next;
         
-        free(rip);
+        node_pool_release(&l->pool, rip);
     }
     
     l->size--;
@@ -92,7 +132,7 @@ list_iterator list_iterator_next(list_iterator it)
 
 int list_insert_before(list_iterator it, value v)
 {
-    node* n = malloc(sizeof(node));
+    node* n = node_pool_acquire(&it.l->pool);
     if (!n)
         return 0;
     
@@ -108,7 +148,7 @@ int list_insert_before(list_iterator it, value v)
 
 int list_insert_after(list_iterator it, value v)
 {
-    node* n = malloc(sizeof(node));
+    node* n = node_pool_acquire(&it.l->pool);
     if (!n)
         return 0;
     
@@ -13,10 +13,26 @@ typedef struct node
     struct node* next;
 } node;
 
+#define NODE_POOL_SLAB_SIZE 128
+
+typedef struct node_slab
+{
+    struct node_slab* next;
+    node nodes[NODE_POOL_SLAB_SIZE];
+} node_slab;
+
+typedef struct
+{
+    node_slab* slabs;
+    int used;
+    node* free_nodes;
+} node_pool;
+
 typedef struct
 {
     node* first;
     int size;
+    node_pool pool;
 } list;
 
 typedef struct
@@ -25,6 +41,10 @@ typedef struct
     node** ptr;
 } list_iterator;
 
+node* node_pool_acquire(node_pool* p);
+void node_pool_release(node_pool* p, node* n);
+void node_pool_release_all(node_pool* p);
+
 list* list_new();
 void list_delete(list* l);
 
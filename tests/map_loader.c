@@ -5,36 +5,67 @@
 
 void get_map_size(FILE* f, int* w, int* h)
 {
-    fseek(f, 0, SEEK_END);
-    long size = ftell(f);
-    rewind(f);
+    int c;
+    int length = 0;
     
-    char line[80];
+    *w = -1;
+    *h = 0;
     
-    fgets(line, 80, f);
+    while ((c = fgetc(f)) != EOF)
+    {
+        if (c == '\n')
+        {
+            if (*w == -1)
+                *w = length;
+            
+            (*h)++;
+            length = 0;
+        }
+        else if (c != '\r')
+        {
+            length++;
+        }
+    }
     
-    *w = strlen(line) - 1;
-    *h = size / *w;
+    if (length > 0)
+    {
+        if (*w == -1)
+            *w = length;
+        
+        (*h)++;
+    }
+    
+    if (*w == -1)
+        *w = 0;
     
     rewind(f);
 }
 
 char** create_map(FILE* f, int* w, int* h)
 {
-    int i;
+    int i, j, c;
     
     get_map_size(f, w, h);
     
     char** map = malloc((*h) * sizeof(char*));
-    char line[80];
     
     for (i = 0; i < *h; i++)
     {
         map[i] = malloc(*w);
         
-        fgets(line, 80, f);
+        for (j = 0; j < *w && (c = fgetc(f)) != EOF && c != '\n'; j++)
+        {
+            if (c == '\r')
+                j--;
+            else
+                map[i][j] = c;
+        }
         
-        memcpy(map[i], line, *w);
+        // Short lines are padded with walls, long ones are cut.
+        if (j < *w)
+            memset(map[i] + j, '*', *w - j);
+        else
+            while ((c = fgetc(f)) != EOF && c != '\n');
     }
     
     fclose(f);
@@ -51,4 +82,3 @@ void destroy_map(char** map, int w, int h)
     
     free(map);
 }
-
@@ -1,6 +1,9 @@
 #include "priority_queue.h"
 
 #include <stdlib.h>
+#include <string.h>
+
+#if PRIORITY_QUEUE_IMPL == PRIORITY_QUEUE_LIST
 
 priority_queue* priority_queue_new(int(*cmp)(value, value))
 {
@@ -18,6 +21,11 @@ void priority_queue_delete(priority_queue* q)
     free(q);
 }
 
+void priority_queue_clear(priority_queue* q)
+{
+    while (list_remove(q->l, 0));
+}
+
 int priority_queue_size(priority_queue* q)
 {
     return list_size(q->l);
@@ -53,3 +61,300 @@ int priority_queue_top(priority_queue* q, value* v)
     
     return 1;
 }
+
+#elif PRIORITY_QUEUE_IMPL == PRIORITY_QUEUE_HEAP
+
+priority_queue* priority_queue_new(int(*cmp)(value, value))
+{
+    priority_queue* q = malloc(sizeof(priority_queue));
+    
+    q->size = 0;
+    q->capacity = 64;
+    q->heap = malloc(q->capacity * sizeof(value));
+    
+    q->slots_capacity = 64;
+    q->slots = malloc(q->slots_capacity * sizeof(int));
+    memset(q->slots, 0xff, q->slots_capacity * sizeof(int));
+    
+    q->cmp_func = cmp;
+    
+    return q;
+}
+
+void priority_queue_delete(priority_queue* q)
+{
+    free(q->heap);
+    free(q->slots);
+    
+    free(q);
+}
+
+void priority_queue_clear(priority_queue* q)
+{
+    for (int i = 0; i < q->size; i++)
+        q->slots[q->heap[i].index] = -1;
+    
+    q->size = 0;
+}
+
+int priority_queue_size(priority_queue* q)
+{
+    return q->size;
+}
+
+static void sift_up(priority_queue* q, int i)
+{
+    value v = q->heap[i];
+    
+    while (i > 0 && q->cmp_func(v, q->heap[(i - 1) / 2]) < 0)
+    {
+        int parent = (i - 1) / 2;
+        
+        q->heap[i] = q->heap[parent];
+        q->slots[q->heap[i].index] = i;
+        
+        i = parent;
+    }
+    
+    q->heap[i] = v;
+    q->slots[v.index] = i;
+}
+
+static void sift_down(priority_queue* q, int i)
+{
+    value v = q->heap[i];
+    
+    while (2 * i + 1 < q->size)
+    {
+        int child = 2 * i + 1;
+        
+        if (child + 1 < q->size && q->cmp_func(q->heap[child + 1], q->heap[child]) < 0)
+            child++;
+        
+        if (q->cmp_func(q->heap[child], v) >= 0)
+            break;
+        
+        q->heap[i] = q->heap[child];
+        q->slots[q->heap[i].index] = i;
+        
+        i = child;
+    }
+    
+    q->heap[i] = v;
+    q->slots[v.index] = i;
+}
+
+void priority_queue_push(priority_queue* q, value v)
+{
+    if (v.index >= q->slots_capacity)
+    {
+        int old_capacity = q->slots_capacity;
+        
+        while (v.index >= q->slots_capacity)
+            q->slots_capacity *= 2;
+        
+        q->slots = realloc(q->slots, q->slots_capacity * sizeof(int));
+        memset(q->slots + old_capacity, 0xff, (q->slots_capacity - old_capacity) * sizeof(int));
+    }
+    
+    int slot = q->slots[v.index];
+    
+    if (slot != -1)
+    {
+        if (q->cmp_func(v, q->heap[slot]) < 0)
+        {
+            q->heap[slot] = v;
+            sift_up(q, slot);
+        }
+    }
+    else
+    {
+        if (q->size == q->capacity)
+        {
+            q->capacity *= 2;
+            q->heap = realloc(q->heap, q->capacity * sizeof(value));
+        }
+        
+        q->heap[q->size] = v;
+        q->size++;
+        
+        sift_up(q, q->size - 1);
+    }
+}
+
+int priority_queue_pop(priority_queue* q)
+{
+    if (q->size == 0)
+        return 0;
+    
+    q->slots[q->heap[0].index] = -1;
+    q->size--;
+    
+    if (q->size > 0)
+    {
+        q->heap[0] = q->heap[q->size];
+        sift_down(q, 0);
+    }
+    
+    return 1;
+}
+
+int priority_queue_top(priority_queue* q, value* v)
+{
+    if (q->size == 0)
+        return 0;
+    
+    *v = q->heap[0];
+    
+    return 1;
+}
+
+#elif PRIORITY_QUEUE_IMPL == PRIORITY_QUEUE_BUCKETS
+
+priority_queue* priority_queue_new(int(*cmp)(value, value))
+{
+    priority_queue* q = malloc(sizeof(priority_queue));
+    
+    memset(q->heads, 0xff, sizeof(q->heads));
+    
+    q->capacity = 0;
+    q->next = NULL;
+    q->prev = NULL;
+    q->keys = NULL;
+    
+    q->size = 0;
+    q->lowest = 0;
+    
+    q->cmp_func = cmp;
+    
+    return q;
+}
+
+void priority_queue_delete(priority_queue* q)
+{
+    free(q->next);
+    free(q->prev);
+    free(q->keys);
+    
+    free(q);
+}
+
+void priority_queue_clear(priority_queue* q)
+{
+    for (int b = 0; q->size > 0 && b < PRIORITY_QUEUE_BUCKET_COUNT; b++)
+    {
+        for (int index = q->heads[b]; index != -1; index = q->next[index])
+        {
+            q->keys[index] = -1;
+            q->size--;
+        }
+    }
+    
+    memset(q->heads, 0xff, sizeof(q->heads));
+    
+    q->size = 0;
+    q->lowest = 0;
+}
+
+int priority_queue_size(priority_queue* q)
+{
+    return q->size;
+}
+
+static void reserve(priority_queue* q, int index)
+{
+    int old_capacity = q->capacity;
+    
+    if (index < q->capacity)
+        return;
+    
+    if (q->capacity == 0)
+        q->capacity = 64;
+    
+    while (index >= q->capacity)
+        q->capacity *= 2;
+    
+    q->next = realloc(q->next, q->capacity * sizeof(int));
+    q->prev = realloc(q->prev, q->capacity * sizeof(int));
+    q->keys = realloc(q->keys, q->capacity * sizeof(int));
+    
+    memset(q->keys + old_capacity, 0xff, (q->capacity - old_capacity) * sizeof(int));
+}
+
+static void unlink_node(priority_queue* q, int index)
+{
+    int b = q->keys[index] % PRIORITY_QUEUE_BUCKET_COUNT;
+    
+    if (q->prev[index] == -1)
+        q->heads[b] = q->next[index];
+    else
+        q->next[q->prev[index]] = q->next[index];
+    
+    if (q->next[index] != -1)
+        q->prev[q->next[index]] = q->prev[index];
+    
+    q->keys[index] = -1;
+}
+
+void priority_queue_push(priority_queue* q, value v)
+{
+    int b = v.weight % PRIORITY_QUEUE_BUCKET_COUNT;
+    
+    reserve(q, v.index);
+    
+    if (q->keys[v.index] != -1)
+    {
+        if (v.weight >= q->keys[v.index])
+            return;
+        
+        unlink_node(q, v.index);
+    }
+    else
+    {
+        if (q->size == 0)
+            q->lowest = v.weight;
+        
+        q->size++;
+    }
+    
+    if (v.weight < q->lowest)
+        q->lowest = v.weight;
+    
+    q->keys[v.index] = v.weight;
+    q->prev[v.index] = -1;
+    q->next[v.index] = q->heads[b];
+    
+    if (q->heads[b] != -1)
+        q->prev[q->heads[b]] = v.index;
+    
+    q->heads[b] = v.index;
+}
+
+int priority_queue_top(priority_queue* q, value* v)
+{
+    if (q->size == 0)
+        return 0;
+    
+    while (q->heads[q->lowest % PRIORITY_QUEUE_BUCKET_COUNT] == -1)
+        q->lowest++;
+    
+    v->index = q->heads[q->lowest % PRIORITY_QUEUE_BUCKET_COUNT];
+    v->weight = q->lowest;
+    
+    return 1;
+}
+
+int priority_queue_pop(priority_queue* q)
+{
+    value v;
+    
+    if (!priority_queue_top(q, &v))
+        return 0;
+    
+    unlink_node(q, v.index);
+    q->size--;
+    
+    return 1;
+}
+
+#endif
@@ -3,14 +3,57 @@
 
 #include "list.h"
 
+#define PRIORITY_QUEUE_LIST 0
+#define PRIORITY_QUEUE_HEAP 1
+#define PRIORITY_QUEUE_BUCKETS 2
+
+#ifndef PRIORITY_QUEUE_IMPL
+#define PRIORITY_QUEUE_IMPL PRIORITY_QUEUE_HEAP
+#endif
+
+#if PRIORITY_QUEUE_IMPL == PRIORITY_QUEUE_LIST
+
 typedef struct
 {
     list* l;
     int (*cmp_func)(value l, value r);
 } priority_queue;
 
+#elif PRIORITY_QUEUE_IMPL == PRIORITY_QUEUE_HEAP
+
+typedef struct
+{
+    value* heap;
+    int size;
+    int capacity;
+    int* slots;
+    int slots_capacity;
+    int (*cmp_func)(value l, value r);
+} priority_queue;
+
+#elif PRIORITY_QUEUE_IMPL == PRIORITY_QUEUE_BUCKETS
+
+#define PRIORITY_QUEUE_BUCKET_COUNT 256
+
+typedef struct
+{
+    int heads[PRIORITY_QUEUE_BUCKET_COUNT];
+    int* next;
+    int* prev;
+    int* keys;
+    int capacity;
+    int size;
+    int lowest;
+    int (*cmp_func)(value l, value r);
+} priority_queue;
+
+#else
+#error "Unknown PRIORITY_QUEUE_IMPL"
+#endif
+
 priority_queue* priority_queue_new(int(*cmp)(value, value));
 void priority_queue_delete(priority_queue* q);
+void priority_queue_clear(priority_queue* q);
 
 int priority_queue_size(priority_queue* q);
 
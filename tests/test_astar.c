@@ -0,0 +1,133 @@
+// Check the A* of player.c against its Dijkstra's algorithm: both must find paths of the
+// same weighted distance, on random pairs of positions and random weights of the entities.
+// Built with -DSHORTEST_PATH_IMPL=SHORTEST_PATH_BIDIRECTIONAL, the bidirectional search is
+// checked too: it must find the very same path as the Dijkstra's algorithm, with the same
+// first step and size. The exit status is 1 if a path differs.
+//
+//     make test
+
+#include "../player.c"
+#include "map_loader.h"
+#include "../tools/common.h"
+
+#define PATH_COUNT 200
+#define WEIGHTS_COUNT 5 // The sets of weights tried per map, the first being the usual one
+
+static vec2 random_walkable(char** map, int w, int h)
+{
+    vec2 p;
+
+    do
+    {
+        p.x = rand() % w;
+        p.y = rand() % h;
+    }
+    while (map[p.y][p.x] == '*' || map[p.y][p.x] == '-');
+
+    return p;
+}
+
+int main(int argc, char *argv[])
+{
+    int mismatches = 0;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "%s <file>...\n", argv[0]);
+        return 1;
+    }
+
+    srand(42);
+
+    for (int m = 1; m < argc; m++)
+    {
+        FILE* f = fopen(argv[m], "r");
+        if (!f)
+        {
+            fprintf(stderr, "could not open file %s for reading\n", argv[m]);
+            return 1;
+        }
+
+        int w, h;
+        char** map = create_map(f, &w, &h);
+        graph g = create_graph(map, w, h);
+        search_arena* a = search_arena_create(w, h);
+
+        long dijkstra_expanded = 0;
+        long astar_expanded = 0;
+#if SHORTEST_PATH_IMPL == SHORTEST_PATH_BIDIRECTIONAL
+        long bidirectional_expanded = 0;
+#endif
+        int map_mismatches = 0;
+
+        for (int k = 0; k < WEIGHTS_COUNT; k++)
+        {
+            entities_weights c = {1, 1, 20, 50};
+
+            // Any weight but 255, which would make the entity a wall.
+            if (k > 0)
+            {
+                c.unexplored = 1 + rand() % 254;
+                c.explored = 1 + rand() % 254;
+                c.energizer = 1 + rand() % 254;
+                c.ghost = 1 + rand() % 254;
+            }
+
+            update_graph(g, c);
+
+            for (int i = 0; i < PATH_COUNT; i++)
+            {
+                vec2 source = random_walkable(map, w, h);
+                vec2 target = random_walkable(map, w, h);
+
+                dijkstra(g, a, source, graph_get_node(g, target));
+                dijkstra_expanded += a->expanded;
+                path_result d = search_arena_get_path(g, a, target);
+
+                astar(g, a, source, target);
+                astar_expanded += a->expanded;
+                path_result s = search_arena_get_path(g, a, target);
+
+                if (d.distance != s.distance)
+                {
+                    printf("%s: from (%d, %d) to (%d, %d) with weights %d %d %d %d, A* found %d instead of %d\n",
+                        argv[m], source.x, source.y, target.x, target.y, c.unexplored, c.explored, c.energizer,
+                        c.ghost, (int)s.distance, (int)d.distance);
+                    map_mismatches++;
+                }
+
+#if SHORTEST_PATH_IMPL == SHORTEST_PATH_BIDIRECTIONAL
+                path_result b = bidirectional_dijkstra(g, a, source, target);
+                bidirectional_expanded += a->expanded;
+
+                if (b.distance != d.distance || b.size != d.size || b.next_move.x != d.next_move.x
+                    || b.next_move.y != d.next_move.y)
+                {
+                    printf("%s: from (%d, %d) to (%d, %d) with weights %d %d %d %d, the bidirectional search "
+                        "found %d in %d steps through (%d, %d) instead of %d in %d steps through (%d, %d)\n",
+                        argv[m], source.x, source.y, target.x, target.y, c.unexplored, c.explored, c.energizer,
+                        c.ghost, (int)b.distance, (int)b.size, b.next_move.x, b.next_move.y, (int)d.distance,
+                        (int)d.size, d.next_move.x, d.next_move.y);
+                    map_mismatches++;
+                }
+#endif
+            }
+        }
+
+        printf("%s: %d paths, Dijkstra expanded %ld nodes, A* expanded %ld nodes (%.1f%%), %d mismatches\n",
+            argv[m], WEIGHTS_COUNT * PATH_COUNT, dijkstra_expanded, astar_expanded,
+            100.0 * astar_expanded / dijkstra_expanded, map_mismatches);
+#if SHORTEST_PATH_IMPL == SHORTEST_PATH_BIDIRECTIONAL
+        printf("%s: the bidirectional search expanded %ld nodes (%.1f%%)\n", argv[m], bidirectional_expanded,
+            100.0 * bidirectional_expanded / dijkstra_expanded);
+#endif
+
+        mismatches += map_mismatches;
+
+        search_arena_destroy(a);
+        dispose_graph(g);
+        destroy_map(map, w, h);
+    }
+
+    return mismatches > 0;
+}
@@ -0,0 +1,164 @@
+// Check the row kernels of player.c, which turn the map into weights with the vector
+// instructions of the machine, against the scalar get_weight_for_entity: classify_row on
+// random rows, then update_graph on random maps, whose weights across the borders go
+// through the padding of pack_neighbor_weights. Every width up to MAX_WIDTH is tried, so
+// that the rows end with every possible remainder of the vector width. The exit status
+// is 1 if a weight differs.
+//
+//     make test
+//
+// The kernel checked is the one player.c selects: build with -mavx2 to check the AVX2
+// one, or with -DMAP_KERNEL_IMPL=MAP_KERNEL_SCALAR to check the tests themselves.
+
+#include "../player.c"
+#include "../tools/common.h"
+
+#define MAX_WIDTH 100 // More than three times the widest vector
+#define MAX_HEIGHT 5
+#define ROWS_PER_WIDTH 20
+#define MAPS_PER_WIDTH 5
+#define MAX_REPORTED 10
+
+static int reported;
+
+static void report(const char* what, int w, int x, int y, int got, int expected)
+{
+    if (reported++ < MAX_REPORTED)
+        printf("%s: width %d at (%d, %d) gave %d instead of %d\n", what, w, x, y, got, expected);
+}
+
+// Mostly the characters of the game, with any other byte from time to time.
+static char random_entity(void)
+{
+    const char entities[] = {PACMAN, WALL, PATH, DOOR, VIRGIN_PATH, ENERGY, GHOST1, GHOST2, GHOST3, GHOST4};
+    int n = sizeof(entities) / sizeof(entities[0]);
+    int r = rand() % (n + 1);
+
+    return r < n ? entities[r] : (char)(1 + rand() % 255);
+}
+
+// Any weight, 255 included.
+static entities_weights random_weights(void)
+{
+    entities_weights c;
+
+    c.unexplored = rand() % 256;
+    c.explored = rand() % 256;
+    c.energizer = rand() % 256;
+    c.ghost = rand() % 256;
+
+    return c;
+}
+
+static int check_classify_row(int w)
+{
+    char* row = malloc(w + 1);
+    unsigned char* weights = malloc(w);
+    unsigned char table[256];
+    int mismatches = 0;
+    int i, x;
+
+    for (i = 0; i < ROWS_PER_WIDTH; i++)
+    {
+        entities_weights c = random_weights();
+
+        for (x = 0; x < w; x++)
+            row[x] = random_entity();
+
+        row[w] = '\0';
+
+        build_weight_table(c, table);
+        classify_row(row, w, c, table, weights);
+
+        for (x = 0; x < w; x++)
+        {
+            unsigned char expected = get_weight_for_entity(row[x], c);
+
+            if (weights[x] != expected)
+            {
+                report("classify_row", w, x, 0, weights[x], expected);
+                mismatches++;
+            }
+        }
+    }
+
+    free(weights);
+    free(row);
+
+    return mismatches;
+}
+
+static int check_update_graph(int w, int h)
+{
+    char** map = malloc(h * sizeof(char*));
+    int mismatches = 0;
+    int x, y, dir;
+
+    for (y = 0; y < h; y++)
+    {
+        map[y] = malloc(w + 1);
+
+        for (x = 0; x < w; x++)
+            map[y][x] = random_entity();
+
+        map[y][w] = '\0';
+    }
+
+    entities_weights c = random_weights();
+    graph g = create_graph(map, w, h);
+
+    update_graph(g, c);
+
+    // The weight to go in a direction is the weight of the entity on the neighbor that
+    // way, mirrored across the borders.
+    for (y = 0; y < h; y++)
+    {
+        for (x = 0; x < w; x++)
+        {
+            int idx = coords_to_graph_index(create_vec2(x, y), w);
+
+            for (dir = 0; dir < 4; dir++)
+            {
+                vec2 n = graph_index_to_coords(graph_get_neighbor_index(w, h, idx, dir), w);
+                unsigned char expected = get_weight_for_entity(map[n.y][n.x], c);
+                unsigned char weight = graph_get_weight(g, idx, dir);
+
+                if (weight != expected)
+                {
+                    report("update_graph", w, x, y, weight, expected);
+                    mismatches++;
+                }
+            }
+        }
+    }
+
+    dispose_graph(g);
+
+    for (y = 0; y < h; y++)
+        free(map[y]);
+
+    free(map);
+
+    return mismatches;
+}
+
+int main(void)
+{
+    int row_mismatches = 0, graph_mismatches = 0;
+    int w, i;
+
+    srand(42);
+
+    for (w = 1; w <= MAX_WIDTH; w++)
+    {
+        row_mismatches += check_classify_row(w);
+
+        for (i = 0; i < MAPS_PER_WIDTH; i++)
+            graph_mismatches += check_update_graph(w, 1 + rand() % MAX_HEIGHT);
+    }
+
+    printf("map kernel %d: %d classify_row mismatches, %d update_graph mismatches, widths 1 to %d\n",
+        MAP_KERNEL_IMPL, row_mismatches, graph_mismatches, MAX_WIDTH);
+
+    return row_mismatches + graph_mismatches > 0;
+}
@@ -0,0 +1,30 @@
+// What the tools share (see common.h).
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "common.h"
+
+#include <time.h>
+
+// The characters of the game and the rewards, as defined by the game engine.
+const char PACMAN = '@';
+const char WALL = '*';
+const char PATH = ' ';
+const char DOOR = '-';
+const char VIRGIN_PATH = '.';
+const char ENERGY = 'O';
+const char GHOST1 = '$';
+const char GHOST2 = '%';
+const char GHOST3 = '#';
+const char GHOST4 = '&';
+const int VIRGIN_PATH_SCORE = 10;
+const int ENERGY_SCORE = 50;
+
+double now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
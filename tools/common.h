@@ -0,0 +1,26 @@
+#ifndef COMMON_H
+#define COMMON_H
+
+// What the tools share: the characters of the game and the rewards, which the game
+// engine (pacman.o) defines and the tools define in its place (common.c), and a clock.
+
+extern const char PACMAN;
+extern const char WALL;
+extern const char PATH;
+extern const char DOOR;
+extern const char VIRGIN_PATH;
+extern const char ENERGY;
+extern const char GHOST1;
+extern const char GHOST2;
+extern const char GHOST3;
+extern const char GHOST4;
+extern const int VIRGIN_PATH_SCORE;
+extern const int ENERGY_SCORE;
+
+/**
+ * @brief Read the monotonic clock
+ * @return The time, in nanoseconds, since an unspecified point
+ */
+double now(void);
+
+#endif // COMMON_H
@@ -0,0 +1,439 @@
+// Measure how long the pacman function takes to decide, over many positions of Pacman,
+// placements of the ghosts and energy states, on the given maps and on generated ones.
+// Every map is measured several times, the runs of all the maps taking turns. The results
+// of every run are written as CSV, and compared against a baseline: a map whose median
+// decision time got slower in every run is reported as a regression.
+//
+//     make bench
+//     make bench-baseline
+//     tools/decision_bench [-n scenarios] [-r runs] [-o results.csv] [-b baseline.csv] [-t percent] <file>...
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "../player.c"
+#include "map_loader.h"
+#include "common.h"
+
+#include <math.h>
+
+#define DEFAULT_SCENARIOS 2000
+#define DEFAULT_RUNS 5
+#define DEFAULT_THRESHOLD 10.0 // Smaller slowdowns are not reported, however reproducible
+#define MAX_MAPS 64
+#define MAX_RUNS 16
+
+// The statistics of a run on a map, as written to the results and read back from the baseline.
+typedef struct
+{
+    char name[64];
+    int run;
+    int w, h;
+    long decisions;
+    double mean, stddev;
+    double p50, p90, p99, max;
+    double per_second;
+    double allocations;
+} bench_stats;
+
+// A generator of its own, so that the scenarios do not depend on the calls the pacman
+// function makes to rand.
+static unsigned long long random_state = 42;
+
+static unsigned int next_random(void)
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+
+    return (unsigned int)(random_state >> 32);
+}
+
+static int compare_doubles(const void* left, const void* right)
+{
+    double a = *(const double*)left, b = *(const double*)right;
+
+    return (a > b) - (a < b);
+}
+
+// Generate a maze surrounded by walls, with some of its walls knocked down so that
+// there is more than one way around, filled with Pacgums and a few energizers.
+static char** generate_map(int w, int h)
+{
+    char** map = malloc(h * sizeof(char*));
+    int* stack = malloc(w * h * sizeof(int));
+    int top = 0;
+
+    for (int y = 0; y < h; y++)
+    {
+        map[y] = malloc(w);
+        memset(map[y], WALL, w);
+    }
+
+    // A depth-first walk over the odd positions, digging the wall between each
+    // position and the next one.
+    map[1][1] = VIRGIN_PATH;
+    stack[top++] = 1 * w + 1;
+
+    while (top > 0)
+    {
+        int x = stack[top - 1] % w, y = stack[top - 1] / w;
+        int dx[4] = {0, 2, 0, -2}, dy[4] = {-2, 0, 2, 0};
+        int options[4], count = 0;
+
+        for (int d = 0; d < 4; d++)
+        {
+            int nx = x + dx[d], ny = y + dy[d];
+
+            if (nx > 0 && nx < w - 1 && ny > 0 && ny < h - 1 && map[ny][nx] == WALL)
+                options[count++] = d;
+        }
+
+        if (count == 0)
+        {
+            top--;
+            continue;
+        }
+
+        int d = options[next_random() % count];
+
+        map[y + dy[d] / 2][x + dx[d] / 2] = VIRGIN_PATH;
+        map[y + dy[d]][x + dx[d]] = VIRGIN_PATH;
+        stack[top++] = (y + dy[d]) * w + x + dx[d];
+    }
+
+    for (int y = 1; y < h - 1; y++)
+    {
+        for (int x = 1; x < w - 1; x++)
+        {
+            if (map[y][x] == WALL && next_random() % 8 == 0)
+                map[y][x] = VIRGIN_PATH;
+            else if (map[y][x] == VIRGIN_PATH && next_random() % 200 == 0)
+                map[y][x] = ENERGY;
+        }
+    }
+
+    free(stack);
+
+    return map;
+}
+
+// Call the pacman function once per scenario, from random positions of Pacman and the
+// ghosts, and gather the statistics of the decision times.
+static void run_map(char** map, int w, int h, int scenarios, bench_stats* s)
+{
+    const char ghosts[4] = {GHOST1, GHOST2, GHOST3, GHOST4};
+    int* walkable = malloc(w * h * sizeof(int));
+    double* times = malloc(scenarios * sizeof(double));
+    int count = 0;
+
+    // Pacman and the ghosts are placed by each scenario.
+    for (int y = 0; y < h; y++)
+    {
+        for (int x = 0; x < w; x++)
+        {
+            char c = map[y][x];
+
+            if (c == PACMAN || c == GHOST1 || c == GHOST2 || c == GHOST3 || c == GHOST4)
+                map[y][x] = c = PATH;
+
+            if (c != WALL && c != DOOR)
+                walkable[count++] = y * w + x;
+        }
+    }
+
+    if (count < 5)
+    {
+        fprintf(stderr, "%s has not enough room for Pacman and the ghosts\n", s->name);
+        exit(EXIT_FAILURE);
+    }
+
+    srand(42);
+    allocation_counters before = allocations;
+
+    for (int i = 0; i < scenarios; i++)
+    {
+        int placed[5];
+        char under[5];
+        int ghost_count = next_random() % 5;
+        bool energy = next_random() % 3 == 0;
+        int remaining = energy ? 1 + next_random() % 100 : 0;
+        direction last = i == 0 ? -1 : (direction)(next_random() % 4);
+
+        // Pacman first, then the ghosts, each on a position of its own.
+        for (int k = 0; k <= ghost_count; k++)
+        {
+            int idx;
+            bool taken;
+
+            do
+            {
+                idx = walkable[next_random() % count];
+                taken = false;
+
+                for (int j = 0; j < k; j++)
+                    taken |= placed[j] == idx;
+            }
+            while (taken);
+
+            placed[k] = idx;
+            under[k] = map[idx / w][idx % w];
+            map[idx / w][idx % w] = k == 0 ? PACMAN : ghosts[k - 1];
+        }
+
+        double start = now();
+        pacman(map, w, h, placed[0] % w, placed[0] / w, last, energy, remaining);
+        times[i] = now() - start;
+
+        for (int k = ghost_count; k >= 0; k--)
+            map[placed[k] / w][placed[k] % w] = under[k];
+    }
+
+    double total = 0, squares = 0;
+
+    for (int i = 0; i < scenarios; i++)
+        total += times[i];
+
+    s->mean = total / scenarios;
+
+    for (int i = 0; i < scenarios; i++)
+        squares += (times[i] - s->mean) * (times[i] - s->mean);
+
+    qsort(times, scenarios, sizeof(double), compare_doubles);
+
+    s->w = w;
+    s->h = h;
+    s->decisions = scenarios;
+    s->stddev = scenarios > 1 ? sqrt(squares / (scenarios - 1)) : 0;
+    s->p50 = times[(scenarios - 1) * 50 / 100];
+    s->p90 = times[(scenarios - 1) * 90 / 100];
+    s->p99 = times[(scenarios - 1) * 99 / 100];
+    s->max = times[scenarios - 1];
+    s->per_second = 1e9 * scenarios / total;
+    s->allocations = (double)(allocations.mallocs - before.mallocs + allocations.reallocs - before.reallocs) / scenarios;
+
+    free(walkable);
+    free(times);
+}
+
+static const char* const header = "map,run,width,height,decisions,mean_ns,stddev_ns,p50_ns,p90_ns,p99_ns,max_ns,decisions_per_s,allocs_per_decision";
+
+static void write_stats(FILE* f, const bench_stats* s)
+{
+    fprintf(f, "%s,%d,%d,%d,%ld,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,%.1f,%.2f\n", s->name, s->run, s->w, s->h, s->decisions,
+        s->mean, s->stddev, s->p50, s->p90, s->p99, s->max, s->per_second, s->allocations);
+}
+
+// Read the statistics written by an earlier invocation, one per run on a map, 0 if there
+// are none.
+static int read_baseline(const char* path, bench_stats* baseline)
+{
+    FILE* f = fopen(path, "r");
+    char line[512];
+    int count = 0;
+
+    if (!f)
+        return 0;
+
+    while (count < MAX_MAPS * MAX_RUNS && fgets(line, sizeof(line), f))
+    {
+        bench_stats* s = &baseline[count];
+
+        if (sscanf(line, "%63[^,],%d,%d,%d,%ld,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf", s->name, &s->run, &s->w, &s->h,
+            &s->decisions, &s->mean, &s->stddev, &s->p50, &s->p90, &s->p99, &s->max, &s->per_second,
+            &s->allocations) == 13)
+            count++;
+    }
+
+    fclose(f);
+
+    return count;
+}
+
+// Gather the medians of the runs on a map, sorted, and return how many there are.
+static int collect_medians(const bench_stats* stats, int count, const char* name, double* medians)
+{
+    int found = 0;
+
+    for (int i = 0; i < count && found < MAX_RUNS; i++)
+        if (strcmp(stats[i].name, name) == 0)
+            medians[found++] = stats[i].p50;
+
+    qsort(medians, found, sizeof(double), compare_doubles);
+
+    return found;
+}
+
+// Tell whether a map got slower than in the baseline. Anything else the machine does can
+// slow a run down, so a run is summed up by its median, which a few slow decisions do not
+// move, and a slowdown is only reported if it reproduces: the median of the run medians
+// must have grown by more than the threshold, and every run must be slower than all the
+// runs of the baseline. Without a real slowdown, the runs all come last by chance once in
+// (runs + baseline runs choose runs) times, i.e. once in 252 with 5 runs on both sides.
+static bool is_regression(const double* base, int base_count, const double* medians, int count,
+    double threshold, double* change, int* slower)
+{
+    double base_median = base[base_count / 2], median = medians[count / 2];
+
+    *change = 100 * (median - base_median) / base_median;
+    *slower = 0;
+
+    for (int i = 0; i < count; i++)
+        *slower += medians[i] > base[base_count - 1];
+
+    return *change > threshold && *slower == count;
+}
+
+int main(int argc, char *argv[])
+{
+    const char* output = "decision_bench.csv";
+    const char* baseline_path = NULL;
+    int scenarios = DEFAULT_SCENARIOS;
+    int runs = DEFAULT_RUNS;
+    double threshold = DEFAULT_THRESHOLD;
+    const char* files[MAX_MAPS];
+    int file_count = 0;
+
+    // Generated maps, to see how the decision time grows with the size of the map.
+    const int generated[][2] = {{63, 47}, {127, 95}, {241, 201}};
+    const int generated_count = sizeof(generated) / sizeof(generated[0]);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            scenarios = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+            runs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            output = argv[++i];
+        else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+            baseline_path = argv[++i];
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+            threshold = atof(argv[++i]);
+        else if (file_count + generated_count < MAX_MAPS)
+            files[file_count++] = argv[i];
+    }
+
+    if (scenarios < 2 || runs < 1 || runs > MAX_RUNS)
+    {
+        fprintf(stderr, "%s [-n scenarios] [-r runs] [-o results.csv] [-b baseline.csv] [-t percent] <file>...\n",
+            argv[0]);
+        return 1;
+    }
+
+    static bench_stats results[MAX_MAPS * MAX_RUNS];
+    static bench_stats baseline[MAX_MAPS * MAX_RUNS];
+    int result_count = 0;
+    int baseline_count = baseline_path ? read_baseline(baseline_path, baseline) : 0;
+
+    char** maps[MAX_MAPS];
+    char names[MAX_MAPS][64];
+    int widths[MAX_MAPS], heights[MAX_MAPS];
+    unsigned long long seeds[MAX_MAPS];
+    int map_count = file_count + generated_count;
+
+    for (int m = 0; m < map_count; m++)
+    {
+        if (m < file_count)
+        {
+            FILE* f = fopen(files[m], "r");
+            if (!f)
+            {
+                fprintf(stderr, "could not open file %s for reading\n", files[m]);
+                return 1;
+            }
+
+            maps[m] = create_map(f, &widths[m], &heights[m]);
+            snprintf(names[m], sizeof(names[m]), "%s", files[m]);
+        }
+        else
+        {
+            widths[m] = generated[m - file_count][0];
+            heights[m] = generated[m - file_count][1];
+            maps[m] = generate_map(widths[m], heights[m]);
+            snprintf(names[m], sizeof(names[m]), "generated-%dx%d", widths[m], heights[m]);
+        }
+
+        // Every run on a map goes through the same scenarios.
+        seeds[m] = random_state;
+    }
+
+    // The maps take turns, so that a slow spell of the machine spreads over all of them
+    // instead of spoiling every run of one map.
+    for (int r = 0; r < runs; r++)
+    {
+        for (int m = 0; m < map_count; m++)
+        {
+            bench_stats* s = &results[result_count++];
+
+            snprintf(s->name, sizeof(s->name), "%s", names[m]);
+            s->run = r;
+            random_state = seeds[m];
+            run_map(maps[m], widths[m], heights[m], scenarios, s);
+        }
+    }
+
+    // Each map is shown by its run of median p50.
+    printf("%-20s %9s %11s %11s %11s %11s %12s %10s\n", "map", "size", "p50", "p90", "p99", "max", "decisions/s", "allocs");
+
+    for (int m = 0; m < map_count; m++)
+    {
+        double medians[MAX_RUNS];
+        int count = collect_medians(results, result_count, names[m], medians);
+        const bench_stats* s = NULL;
+
+        for (int i = 0; i < result_count && !s; i++)
+            if (strcmp(results[i].name, names[m]) == 0 && results[i].p50 == medians[count / 2])
+                s = &results[i];
+
+        printf("%-20s %4dx%-4d %8.1f us %8.1f us %8.1f us %8.1f us %12.0f %10.2f\n", s->name, s->w, s->h,
+            s->p50 / 1e3, s->p90 / 1e3, s->p99 / 1e3, s->max / 1e3, s->per_second, s->allocations);
+
+        destroy_map(maps[m], widths[m], heights[m]);
+    }
+
+    FILE* f = fopen(output, "w");
+    if (!f)
+    {
+        fprintf(stderr, "could not open file %s for writing\n", output);
+        return 1;
+    }
+
+    fprintf(f, "%s\n", header);
+    for (int i = 0; i < result_count; i++)
+        write_stats(f, &results[i]);
+
+    fclose(f);
+
+    if (baseline_path && baseline_count == 0)
+    {
+        printf("\nno baseline in %s, run make bench-baseline to store one\n", baseline_path);
+        return 0;
+    }
+
+    // Only the maps found in the baseline as well can be compared.
+    int regressions = 0;
+
+    if (baseline_count > 0)
+        printf("\n%-20s %11s %11s %9s %12s\n", "map", "baseline", "p50", "change", "slower runs");
+
+    for (int m = 0; m < map_count; m++)
+    {
+        double base[MAX_RUNS], medians[MAX_RUNS];
+        int base_runs = collect_medians(baseline, baseline_count, names[m], base);
+        int count = collect_medians(results, result_count, names[m], medians);
+        double change;
+        int slower;
+
+        if (base_runs == 0)
+            continue;
+
+        bool regression = is_regression(base, base_runs, medians, count, threshold, &change, &slower);
+
+        printf("%-20s %8.1f us %8.1f us %+8.1f%% %10d/%d%s\n", names[m], base[base_runs / 2] / 1e3,
+            medians[count / 2] / 1e3, change, slower, count, regression ? "  REGRESSION" : "");
+
+        regressions += regression;
+    }
+
+    return regressions > 0;
+}
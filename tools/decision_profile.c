@@ -0,0 +1,189 @@
+// Play seeded games with the simulator, the pacman function being built with the
+// instrumentation (-DDECISION_STATS), and tell where the time of a decision goes: the
+// wall time, the hardware counters when the system allows reading them, and the work of
+// the searches, phase after phase, and the calls made to the allocator (-DALLOCATION_STATS).
+// Each game is written as a line of the results:
+//
+//     map,seed,decisions,<phase>_ns,<phase>_cycles,<phase>_instructions,<phase>_cache_misses,...,pushes,pops,expanded,searches,mallocs,reallocs,frees
+//
+//     make profile
+//     tools/decision_profile [-n games] [-s seed] [-l max rounds] [-m easy|original] [-o results.csv] <file>...
+
+#define _DEFAULT_SOURCE
+#define DECISION_STATS
+#define ALLOCATION_STATS
+
+#include "../player.c"
+#define PACMAN_H // Included by player.c
+#include "simulator.h"
+#include "map_loader.h"
+#include "common.h"
+
+#define DEFAULT_GAMES 20
+#define DEFAULT_MAX_ROUNDS 10000 // As tools/simulate
+
+static void write_header(FILE* f)
+{
+    int p;
+
+    fprintf(f, "map,seed,decisions");
+
+    for (p = 0; p < PHASE_COUNT; p++)
+    {
+        const char* name = decision_phase_name(p);
+
+        fprintf(f, ",%s_ns,%s_cycles,%s_instructions,%s_cache_misses", name, name, name, name);
+    }
+
+    fprintf(f, ",pushes,pops,expanded,searches,mallocs,reallocs,frees\n");
+}
+
+static void write_game(FILE* f, const char* map, unsigned int seed, const decision_stats* s,
+    const allocation_counters* a)
+{
+    int p;
+
+    fprintf(f, "%s,%u,%lu", map, seed, s->decisions);
+
+    for (p = 0; p < PHASE_COUNT; p++)
+    {
+        fprintf(f, ",%llu,%llu,%llu,%llu", s->phases[p].ns, s->phases[p].cycles, s->phases[p].instructions,
+            s->phases[p].cache_misses);
+    }
+
+    fprintf(f, ",%lu,%lu,%lu,%lu,%lu,%lu,%lu\n", s->pushes, s->pops, s->expanded, s->searches, a->mallocs, a->reallocs,
+        a->frees);
+}
+
+static void print_summary(const char* map, const decision_stats* s, const allocation_counters* a)
+{
+    unsigned long long total = 0;
+    int p;
+
+    for (p = 0; p < PHASE_COUNT; p++)
+        total += s->phases[p].ns;
+
+    printf("%s: %lu decisions, %.2f us each\n", map, s->decisions, s->decisions > 0 ? total / 1e3 / s->decisions : 0);
+    printf("  %-16s %8s %10s %7s", "phase", "runs", "us/run", "share");
+
+    if (s->hardware)
+        printf(" %12s %12s %6s %12s", "cycles/run", "instr/run", "IPC", "misses/run");
+
+    printf("\n");
+
+    for (p = 0; p < PHASE_COUNT; p++)
+    {
+        const phase_stats* ph = &s->phases[p];
+        double runs = ph->runs > 0 ? ph->runs : 1;
+
+        printf("  %-16s %8lu %10.2f %6.1f%%", decision_phase_name(p), ph->runs, ph->ns / 1e3 / runs,
+            total > 0 ? 100.0 * ph->ns / total : 0);
+
+        if (s->hardware)
+        {
+            printf(" %12.0f %12.0f %6.2f %12.1f", ph->cycles / runs, ph->instructions / runs,
+                ph->cycles > 0 ? (double)ph->instructions / ph->cycles : 0, ph->cache_misses / runs);
+        }
+
+        printf("\n");
+    }
+
+    if (!s->hardware)
+        printf("  (the hardware counters could not be read: see /proc/sys/kernel/perf_event_paranoid)\n");
+
+    double decisions = s->decisions > 0 ? s->decisions : 1;
+
+    printf("  per decision: %.1f searches, %.1f pushes, %.1f pops, %.1f nodes expanded\n", s->searches / decisions,
+        s->pushes / decisions, s->pops / decisions, s->expanded / decisions);
+    printf("  per decision: %.1f malloc, %.1f realloc, %.1f free\n\n", a->mallocs / decisions, a->reallocs / decisions,
+        a->frees / decisions);
+}
+
+int main(int argc, char *argv[])
+{
+    int games = DEFAULT_GAMES;
+    unsigned int seed = 1;
+    long max_rounds = DEFAULT_MAX_ROUNDS;
+    bool original = false;
+    const char* output = "decision_profile.csv";
+    int first_file = argc;
+
+    for (int i = 1; i < argc && first_file == argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            games = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-l") && i + 1 < argc)
+            max_rounds = atol(argv[++i]);
+        else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+            original = !strcmp(argv[++i], "original");
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            output = argv[++i];
+        else
+            first_file = i;
+    }
+
+    if (games < 1 || first_file == argc)
+    {
+        fprintf(stderr, "%s [-n games] [-s seed] [-l max rounds] [-m easy|original] [-o results.csv] <file>...\n", argv[0]);
+        return 1;
+    }
+
+    FILE* out = fopen(output, "w");
+    if (!out)
+    {
+        fprintf(stderr, "could not open file %s for writing\n", output);
+        return 1;
+    }
+
+    write_header(out);
+
+    for (int m = first_file; m < argc; m++)
+    {
+        FILE* f = fopen(argv[m], "r");
+        if (!f)
+        {
+            fprintf(stderr, "could not open file %s for reading\n", argv[m]);
+            return 1;
+        }
+
+        int w, h;
+        char** map = create_map(f, &w, &h);
+        decision_stats level = {0};
+        allocation_counters level_allocations = {0};
+
+        for (int i = 0; i < games; i++)
+        {
+            sim_game* game = sim_create(map, w, h, original);
+            if (!game)
+            {
+                fprintf(stderr, "%s lacks Pacman, a ghost or their door\n", argv[m]);
+                return 1;
+            }
+
+            // The totals are summed by the pacman function, game after game.
+            memset(&decision_totals, 0, sizeof(decision_totals));
+            memset(&allocation_totals, 0, sizeof(allocation_totals));
+
+            srand(seed + i);
+            sim_play(game, max_rounds);
+
+            write_game(out, argv[m], seed + i, &decision_totals, &allocation_totals);
+            decision_stats_add(&level, &decision_totals);
+            level_allocations.mallocs += allocation_totals.mallocs;
+            level_allocations.reallocs += allocation_totals.reallocs;
+            level_allocations.frees += allocation_totals.frees;
+
+            sim_destroy(game);
+        }
+
+        print_summary(argv[m], &level, &level_allocations);
+
+        destroy_map(map, w, h);
+    }
+
+    fclose(out);
+
+    return 0;
+}
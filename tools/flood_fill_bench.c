@@ -0,0 +1,116 @@
+// Compare the bit-parallel breadth-first search with the searches based on the priority
+// queue, on maps where every position costs 1 to enter.
+//
+//     make bench-flood-fill
+//     tools/flood_fill_bench level1.map level2.map level3.map
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "../player.c"
+#include "map_loader.h"
+#include "common.h"
+
+#define SEARCH_COUNT 2000
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "%s <file>...\n", argv[0]);
+        return 1;
+    }
+    
+    entities_weights unit = {1, 1, 1, 1};
+    
+    printf("%-20s %8s %14s %14s %14s %11s\n", "map", "nodes", "flood fill", "field", "shortest path", "mismatches");
+    
+    for (int m = 1; m < argc; m++)
+    {
+        FILE* f = fopen(argv[m], "r");
+        if (!f)
+        {
+            fprintf(stderr, "could not open file %s for reading\n", argv[m]);
+            return 1;
+        }
+        
+        int w, h;
+        char** map = create_map(f, &w, &h);
+        
+        // Pacman cannot be walked into, unlike the position it searches from: the
+        // searches start from anywhere but where Pacman stands on the map.
+        for (int y = 0; y < h; y++)
+            for (int x = 0; x < w; x++)
+                if (map[y][x] == PACMAN)
+                    map[y][x] = PATH;
+        
+        graph g = create_graph(map, w, h);
+        search_arena* flood = search_arena_create(w, h);
+        search_arena* queue = search_arena_create(w, h);
+        int n = g.adj.node_count;
+        
+        if (n == 0)
+        {
+            fprintf(stderr, "%s has nowhere to walk\n", argv[m]);
+            return 1;
+        }
+        
+        update_graph(g, unit);
+        
+        // The same sources and targets for every search.
+        srand(42);
+        
+        vec2* sources = malloc(SEARCH_COUNT * sizeof(vec2));
+        vec2* targets = malloc(SEARCH_COUNT * sizeof(vec2));
+        
+        for (int i = 0; i < SEARCH_COUNT; i++)
+        {
+            sources[i] = g.adj.positions[rand() % n];
+            targets[i] = g.adj.positions[rand() % n];
+        }
+        
+        double start = now();
+        for (int i = 0; i < SEARCH_COUNT; i++)
+            flood_fill_search(g, flood, sources[i]);
+        double flood_time = (now() - start) / SEARCH_COUNT;
+        
+        start = now();
+        for (int i = 0; i < SEARCH_COUNT; i++)
+            compute_distance_field(g, queue, sources[i]);
+        double field_time = (now() - start) / SEARCH_COUNT;
+        
+        start = now();
+        for (int i = 0; i < SEARCH_COUNT; i++)
+            shortest_path(g, queue, sources[i], targets[i]);
+        double path_time = (now() - start) / SEARCH_COUNT;
+        
+        // Every distance must match the one found with the priority queue.
+        int mismatches = 0;
+        
+        for (int i = 0; i < SEARCH_COUNT; i += SEARCH_COUNT / 20)
+        {
+            flood_fill_search(g, flood, sources[i]);
+            compute_distance_field(g, queue, sources[i]);
+            
+            for (int k = 0; k < n; k++)
+            {
+                path_result a = search_arena_get_path(g, flood, g.adj.positions[k]);
+                path_result b = search_arena_get_path(g, queue, g.adj.positions[k]);
+                
+                if (a.distance != b.distance)
+                    mismatches++;
+            }
+        }
+        
+        printf("%-20s %8d %11.2f us %11.2f us %11.2f us %11d\n", argv[m], n,
+            flood_time / 1e3, field_time / 1e3, path_time / 1e3, mismatches);
+        
+        free(sources);
+        free(targets);
+        search_arena_destroy(flood);
+        search_arena_destroy(queue);
+        dispose_graph(g);
+        destroy_map(map, w, h);
+    }
+    
+    return 0;
+}
@@ -0,0 +1,139 @@
+// Wrappers of the C library functions the game engine (pacman.o) calls to draw the game
+// and wait between the rounds, so that a game is played at full speed without printing
+// anything. They are linked in with -Wl,--wrap=<function>, which sends the calls that
+// pacman.o and player.o make to __wrap_<function> instead.
+//
+// The score and the number of moves are read from what the game engine prints, and the
+// line it appends to pacman.csv; a line sums the game up when it ends:
+//
+//     make pacman-headless
+//     ./pacman-headless [-csv on] [-mode easy|original] <file>
+//     level1.map,16860,361,eaten
+//
+// When PACMAN_SEED is set, it replaces the time the game engine seeds rand with, so that
+// a game can be played again.
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+int __real_printf(const char* format, ...);
+int __real_fprintf(FILE* f, const char* format, ...);
+
+static char filename[256] = "?";
+static long score;
+static long rounds = -1; // The map is printed once before the first move
+static const char* outcome = "won";
+static bool logged; // Whether the game engine appended the game to pacman.csv
+static long logged_score;
+
+int __wrap_usleep(unsigned int usec)
+{
+    (void)usec;
+
+    return 0;
+}
+
+int __wrap_putchar(int c)
+{
+    return c;
+}
+
+int __wrap_puts(const char* s)
+{
+    (void)s;
+
+    return 1;
+}
+
+int __wrap_printf(const char* format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+
+    // The score is printed with the map, once per round.
+    if (!strncmp(format, "SCORE:", 6))
+    {
+        score = va_arg(args, long);
+        rounds++;
+    }
+    else if (!strcmp(format, ", filename=%s"))
+        snprintf(filename, sizeof(filename), "%s", va_arg(args, const char*));
+    else if (!strcmp(format, "\n%s\n\a"))
+    {
+        // How a game was lost is printed with this format.
+        const char* message = va_arg(args, const char*);
+
+        if (strstr(message, "wall"))
+            outcome = "wall";
+        else if (strstr(message, "eaten"))
+            outcome = "eaten";
+        else if (strstr(message, "stuck"))
+            outcome = "stuck";
+    }
+    else if (!strncmp(format, "Error", 5))
+        vfprintf(stderr, format, args);
+
+    va_end(args);
+
+    return 0;
+}
+
+int __wrap_fprintf(FILE* f, const char* format, ...)
+{
+    va_list args;
+    int written;
+
+    va_start(args, format);
+
+    // The line appended to pacman.csv: the names of the authors, the map, and the score.
+    if (!strcmp(format, "%s,%s,%ld\n"))
+    {
+        va_list fields;
+
+        va_copy(fields, args);
+        (void)va_arg(fields, const char*);
+        (void)va_arg(fields, const char*);
+        logged_score = va_arg(fields, long);
+        logged = true;
+        va_end(fields);
+    }
+
+    written = vfprintf(f, format, args);
+    va_end(args);
+
+    return written;
+}
+
+time_t __real_time(time_t* t);
+
+time_t __wrap_time(time_t* t)
+{
+    const char* seed = getenv("PACMAN_SEED");
+
+    if (!seed)
+        return __real_time(t);
+
+    time_t value = (time_t)strtol(seed, NULL, 10);
+
+    if (t)
+        *t = value;
+
+    return value;
+}
+
+// Sum the game up once the game engine returns from main.
+__attribute__((destructor)) static void report(void)
+{
+    if (rounds < 0)
+        return;
+
+    if (logged && logged_score != score)
+        __real_fprintf(stderr, "the score in pacman.csv (%ld) differs from the one printed (%ld)\n", logged_score, score);
+
+    __real_printf("%s,%ld,%ld,%s\n", filename, score, rounds, outcome);
+}
@@ -0,0 +1,296 @@
+// Writing and reading the logs of the calls made to the pacman function (see record.h).
+
+#include "record.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void put_unsigned(FILE* f, unsigned long value)
+{
+    while (value >= 0x80)
+    {
+        fputc((int)(value & 0x7f) | 0x80, f);
+        value >>= 7;
+    }
+
+    fputc((int)value, f);
+}
+
+// The small negative values, such as a missing last direction, take a single byte.
+static void put_signed(FILE* f, long value)
+{
+    put_unsigned(f, value < 0 ? ((unsigned long)-(value + 1) << 1) | 1 : (unsigned long)value << 1);
+}
+
+static bool get_unsigned(FILE* f, unsigned long* value)
+{
+    int shift = 0, c;
+
+    *value = 0;
+
+    do
+    {
+        if ((c = fgetc(f)) == EOF || shift > 63)
+            return false;
+
+        *value |= (unsigned long)(c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+
+    return true;
+}
+
+static bool get_signed(FILE* f, long* value)
+{
+    unsigned long u;
+
+    if (!get_unsigned(f, &u))
+        return false;
+
+    *value = u & 1 ? -(long)(u >> 1) - 1 : (long)(u >> 1);
+
+    return true;
+}
+
+static bool get_int(FILE* f, int* value)
+{
+    long v;
+
+    if (!get_signed(f, &v))
+        return false;
+
+    *value = (int)v;
+
+    return true;
+}
+
+// Give the frame a map of the given dimensions, which the next frame cannot be a delta of.
+static void resize(record_log* log, int w, int h)
+{
+    record_frame* frame = &log->frame;
+    int j;
+
+    if (frame->map && frame->w == w && frame->h == h)
+        return;
+
+    for (j = 0; frame->map && j < frame->h; j++)
+        free(frame->map[j]);
+
+    free(frame->map);
+    free(log->previous);
+
+    frame->map = malloc(h * sizeof(char*));
+
+    for (j = 0; j < h; j++)
+        frame->map[j] = calloc(w + 1, 1);
+
+    frame->w = w;
+    frame->h = h;
+    log->previous = calloc((size_t)w * h, 1);
+    log->key = true;
+}
+
+record_log* record_open(const char* path, bool writing)
+{
+    char magic[sizeof(RECORD_MAGIC)];
+    FILE* f = fopen(path, writing ? "wb" : "rb");
+
+    if (!f)
+        return NULL;
+
+    if (writing)
+        fwrite(RECORD_MAGIC, 1, sizeof(RECORD_MAGIC), f);
+    else if (fread(magic, 1, sizeof(magic), f) != sizeof(magic) || memcmp(magic, RECORD_MAGIC, sizeof(magic)) != 0)
+    {
+        fclose(f);
+        return NULL;
+    }
+
+    record_log* log = calloc(1, sizeof(record_log));
+    log->f = f;
+    log->writing = writing;
+    log->key = true;
+
+    return log;
+}
+
+void record_close(record_log* log)
+{
+    int j;
+
+    fclose(log->f);
+
+    for (j = 0; log->frame.map && j < log->frame.h; j++)
+        free(log->frame.map[j]);
+
+    free(log->frame.map);
+    free(log->frame.draws);
+    free(log->previous);
+    free(log);
+}
+
+void record_set_map(record_log* log, char** map, int w, int h)
+{
+    int j;
+
+    resize(log, w, h);
+
+    for (j = 0; j < h; j++)
+        memcpy(log->frame.map[j], map[j], w);
+}
+
+void record_add_draw(record_log* log, unsigned int value)
+{
+    record_frame* frame = &log->frame;
+
+    if (frame->draw_count == frame->draw_capacity)
+    {
+        frame->draw_capacity = frame->draw_capacity > 0 ? 2 * frame->draw_capacity : 16;
+        frame->draws = realloc(frame->draws, frame->draw_capacity * sizeof(unsigned int));
+    }
+
+    frame->draws[frame->draw_count++] = value;
+}
+
+bool record_write(record_log* log)
+{
+    const record_frame* frame = &log->frame;
+    FILE* f = log->f;
+    int w = frame->w, h = frame->h;
+    int i, j;
+
+    // A game starts from a whole map, so that it can be read on its own.
+    if (log->key || frame->lastdirection == -1)
+    {
+        fputc(RECORD_KEY, f);
+        put_unsigned(f, w);
+        put_unsigned(f, h);
+
+        for (j = 0; j < h; j++)
+            fwrite(frame->map[j], 1, w, f);
+    }
+    else
+    {
+        long changes = 0, last = -1;
+
+        for (j = 0; j < h; j++)
+        {
+            for (i = 0; i < w; i++)
+                changes += frame->map[j][i] != log->previous[j * w + i];
+        }
+
+        fputc(RECORD_DELTA, f);
+        put_unsigned(f, changes);
+
+        for (j = 0; j < h; j++)
+        {
+            for (i = 0; i < w; i++)
+            {
+                long idx = (long)j * w + i;
+
+                if (frame->map[j][i] == log->previous[idx])
+                    continue;
+
+                put_unsigned(f, idx - last - 1);
+                fputc((unsigned char)frame->map[j][i], f);
+                last = idx;
+            }
+        }
+    }
+
+    for (j = 0; j < h; j++)
+        memcpy(log->previous + j * w, frame->map[j], w);
+
+    put_signed(f, frame->x);
+    put_signed(f, frame->y);
+    put_signed(f, frame->lastdirection);
+    fputc(frame->energy, f);
+    put_signed(f, frame->remainingenergymoderounds);
+    put_signed(f, frame->decision);
+    put_unsigned(f, frame->draw_count);
+
+    for (i = 0; i < frame->draw_count; i++)
+        put_unsigned(f, frame->draws[i]);
+
+    log->key = false;
+    log->frame.draw_count = 0;
+    log->frames++;
+
+    return !ferror(f);
+}
+
+bool record_read(record_log* log)
+{
+    record_frame* frame = &log->frame;
+    FILE* f = log->f;
+    unsigned long w, h, changes, skipped, count, value;
+    long idx = -1, v;
+    int kind, c, j;
+
+    if ((kind = fgetc(f)) == EOF)
+        return false;
+
+    if (kind == RECORD_KEY)
+    {
+        if (!get_unsigned(f, &w) || !get_unsigned(f, &h) || w == 0 || h == 0)
+            return false;
+
+        resize(log, (int)w, (int)h);
+
+        for (j = 0; j < frame->h; j++)
+        {
+            if (fread(frame->map[j], 1, frame->w, f) != (size_t)frame->w)
+                return false;
+        }
+    }
+    else if (kind == RECORD_DELTA && frame->map)
+    {
+        if (!get_unsigned(f, &changes))
+            return false;
+
+        for (; changes > 0; changes--)
+        {
+            if (!get_unsigned(f, &skipped) || (c = fgetc(f)) == EOF)
+                return false;
+
+            idx += skipped + 1;
+
+            if (idx >= (long)frame->w * frame->h)
+                return false;
+
+            frame->map[idx / frame->w][idx % frame->w] = (char)c;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    if (!get_int(f, &frame->x) || !get_int(f, &frame->y) || !get_signed(f, &v))
+        return false;
+
+    frame->lastdirection = (direction)v;
+
+    if ((c = fgetc(f)) == EOF || !get_int(f, &frame->remainingenergymoderounds) || !get_signed(f, &v))
+        return false;
+
+    frame->energy = c != 0;
+    frame->decision = (direction)v;
+
+    if (!get_unsigned(f, &count))
+        return false;
+
+    frame->draw_count = 0;
+
+    for (; count > 0; count--)
+    {
+        if (!get_unsigned(f, &value))
+            return false;
+
+        record_add_draw(log, (unsigned int)value);
+    }
+
+    log->frames++;
+
+    return true;
+}
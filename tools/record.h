@@ -0,0 +1,103 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// pacman.h has no include guard: a file which includes it already, as player.c does,
+// defines PACMAN_H before including this header.
+#ifndef PACMAN_H
+#include "../pacman.h"
+#endif
+
+// A log of the calls made to the pacman function: their arguments, the decision made,
+// and the values rand returned during the call, so that the call can be made again with
+// the same random draws. The file starts with RECORD_MAGIC, followed by the frames:
+//
+//     kind          1 byte, RECORD_KEY or RECORD_DELTA
+//     RECORD_KEY:   w, h, then the w * h characters of the map, row after row
+//     RECORD_DELTA: the number of positions that changed since the previous frame, then for
+//                   each one the number of positions skipped since the previous change, and
+//                   its new character
+//     x, y, lastdirection, energy, remainingenergymoderounds, decision
+//     the number of values rand returned, then the values
+//
+// The numbers are written as variable-length integers, 7 bits a byte, the signed ones in
+// zigzag order. A key frame starts every game, and every change of the map dimensions.
+
+#define RECORD_MAGIC "PACREC1"
+
+#define RECORD_KEY 0
+#define RECORD_DELTA 1
+
+// A call of the pacman function.
+typedef struct
+{
+    char** map; // h rows of w characters, each row ended by a '\0'
+    int w, h;
+    int x, y;
+    direction lastdirection;
+    bool energy;
+    int remainingenergymoderounds;
+    direction decision;
+    unsigned int* draws; // The values returned by rand during the call
+    int draw_count;
+    int draw_capacity;
+} record_frame;
+
+// A log being written or read, and the frame it is at.
+typedef struct
+{
+    FILE* f;
+    bool writing;
+    record_frame frame;
+    char* previous; // The map of the previous frame, row after row
+    bool key; // Whether the next frame written starts again from the whole map
+    long frames;
+} record_log;
+
+/**
+ * @brief Create a log, or open one to read it
+ * @param path The file
+ * @param writing Whether the log is created, or read
+ * @return The log, NULL if the file could not be opened or is not a log
+ */
+record_log* record_open(const char* path, bool writing);
+
+/**
+ * @brief Close a log
+ * @param log The log
+ */
+void record_close(record_log* log);
+
+/**
+ * @brief Set the map of the frame to write, resizing it if needed
+ * @param log The log being written
+ * @param map The map given to the pacman function
+ * @param w The width of the map
+ * @param h The height of the map
+ */
+void record_set_map(record_log* log, char** map, int w, int h);
+
+/**
+ * @brief Add a value returned by rand to the frame to write
+ * @param log The log being written
+ * @param value The value
+ */
+void record_add_draw(record_log* log, unsigned int value);
+
+/**
+ * @brief Write the frame of the log, then start a new one without any draw
+ * @param log The log being written
+ * @return False if the frame could not be written
+ */
+bool record_write(record_log* log);
+
+/**
+ * @brief Read the next frame into the frame of the log
+ * @param log The log being read
+ * @return False at the end of the log, or if it is truncated
+ */
+bool record_read(record_log* log);
+
+#endif // RECORD_H
@@ -0,0 +1,80 @@
+// Wrappers recording every call the game engine (pacman.o) makes to the pacman function,
+// with the values rand returned during the call (see record.h). They are linked in with
+// -Wl,--wrap=pacman,--wrap=rand, along with the wrappers of tools/headless.c, so that
+// games are recorded at full speed:
+//
+//     make pacman-record
+//     PACMAN_SEED=1 PACMAN_RECORD=level1.rec ./pacman-record level1.map
+//     tools/replay level1.rec
+//
+// The calls are recorded into pacman.rec when PACMAN_RECORD is not set.
+
+#include "record.h"
+
+#include <stdlib.h>
+
+direction __real_pacman(char** map, int xsize, int ysize, int x, int y, direction lastdirection, bool energy,
+    int remainingenergymoderounds);
+int __real_rand(void);
+
+static record_log* recording;
+static bool deciding; // Whether the pacman function is being called
+
+int __wrap_rand(void)
+{
+    int value = __real_rand();
+
+    // The draws of the game engine depend on the seed; only those of the pacman function
+    // are needed to make the same decisions again.
+    if (deciding && recording)
+        record_add_draw(recording, (unsigned int)value);
+
+    return value;
+}
+
+direction __wrap_pacman(char** map, int xsize, int ysize, int x, int y, direction lastdirection, bool energy,
+    int remainingenergymoderounds)
+{
+    direction d;
+
+    if (!recording)
+    {
+        const char* path = getenv("PACMAN_RECORD");
+
+        recording = record_open(path ? path : "pacman.rec", true);
+
+        if (!recording)
+            fprintf(stderr, "could not open file %s for writing\n", path ? path : "pacman.rec");
+    }
+
+    if (!recording)
+        return __real_pacman(map, xsize, ysize, x, y, lastdirection, energy, remainingenergymoderounds);
+
+    // The map is kept before the call, which could write into it.
+    record_frame* frame = &recording->frame;
+
+    record_set_map(recording, map, xsize, ysize);
+    frame->x = x;
+    frame->y = y;
+    frame->lastdirection = lastdirection;
+    frame->energy = energy;
+    frame->remainingenergymoderounds = remainingenergymoderounds;
+
+    deciding = true;
+    d = __real_pacman(map, xsize, ysize, x, y, lastdirection, energy, remainingenergymoderounds);
+    deciding = false;
+
+    frame->decision = d;
+
+    if (!record_write(recording))
+        fprintf(stderr, "could not write the call to the log\n");
+
+    return d;
+}
+
+// Write what is left once the game engine returns from main.
+__attribute__((destructor)) static void close_recording(void)
+{
+    if (recording)
+        record_close(recording);
+}
@@ -0,0 +1,174 @@
+// Make the calls of a log recorded by pacman-record again, as fast as possible, and check
+// that the pacman function makes the same decisions. The values rand returned during each
+// recorded call are returned again, in the same order, so that the decisions only depend
+// on the version of the pacman function, not on the game engine: the one built in here
+// can be any variant, e.g. make tools/replay REPLAY_FLAGS=-DPERSISTENT_ENGINE.
+//
+//     make replay
+//     tools/replay [-n passes] [-q] <file>...
+//
+// Only the time spent in the pacman function is measured. The exit status is 1 if a
+// decision differs.
+
+#define _DEFAULT_SOURCE
+
+#include "../player.c"
+#define PACMAN_H // Included by player.c
+#include "record.h"
+#include "common.h"
+
+#include <math.h>
+
+#define MAX_REPORTED 10 // The differing decisions that are printed, per file
+
+int __real_rand(void);
+
+// The draws of the call being made again.
+static const record_frame* replaying;
+static int next_draw;
+static long extra_draws; // Made beyond the recorded ones, by a variant drawing more
+
+int __wrap_rand(void)
+{
+    if (replaying && next_draw < replaying->draw_count)
+        return (int)replaying->draws[next_draw++];
+
+    extra_draws++;
+
+    return __real_rand();
+}
+
+static int by_time(const void* a, const void* b)
+{
+    double ta = *(const double*)a, tb = *(const double*)b;
+
+    return (ta > tb) - (ta < tb);
+}
+
+int main(int argc, char *argv[])
+{
+    int passes = 1;
+    bool quiet = false;
+    int first_file = argc;
+    int differing_files = 0;
+
+    for (int i = 1; i < argc && first_file == argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            passes = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-q"))
+            quiet = true;
+        else
+            first_file = i;
+    }
+
+    if (passes < 1 || first_file == argc)
+    {
+        fprintf(stderr, "%s [-n passes] [-q] <file>...\n", argv[0]);
+        return 1;
+    }
+
+    printf("%-24s %8s %7s %10s %12s %9s %9s %9s %9s\n", "file", "calls", "games", "differing", "decisions/s",
+        "mean", "p50", "p99", "max");
+
+    for (int m = first_file; m < argc; m++)
+    {
+        long calls = 0, games = 0, differing = 0;
+        long capacity = 1024;
+        double* times = malloc(capacity * sizeof(double));
+        double total = 0;
+
+        extra_draws = 0;
+
+        for (int pass = 0; pass < passes; pass++)
+        {
+            record_log* log = record_open(argv[m], false);
+            if (!log)
+            {
+                fprintf(stderr, "could not read the log %s\n", argv[m]);
+                return 1;
+            }
+
+            record_frame* frame = &log->frame;
+            int w = 0, h = 0;
+            char** map = NULL;
+
+            while (record_read(log))
+            {
+                // The pacman function is given its own copy of the map, as by the game engine.
+                if (frame->w != w || frame->h != h)
+                {
+                    for (int j = 0; j < h; j++)
+                        free(map[j]);
+
+                    free(map);
+
+                    w = frame->w;
+                    h = frame->h;
+                    map = malloc(h * sizeof(char*));
+
+                    for (int j = 0; j < h; j++)
+                        map[j] = malloc(w + 1);
+                }
+
+                for (int j = 0; j < h; j++)
+                    memcpy(map[j], frame->map[j], w + 1);
+
+                replaying = frame;
+                next_draw = 0;
+
+                double start = now();
+                direction d = pacman(map, w, h, frame->x, frame->y, frame->lastdirection, frame->energy,
+                    frame->remainingenergymoderounds);
+                double elapsed = now() - start;
+
+                replaying = NULL;
+
+                if (calls == capacity)
+                {
+                    capacity *= 2;
+                    times = realloc(times, capacity * sizeof(double));
+                }
+
+                times[calls++] = elapsed;
+                total += elapsed;
+                games += frame->lastdirection == -1;
+
+                if (d != frame->decision)
+                {
+                    if (!quiet && differing < MAX_REPORTED && pass == 0)
+                    {
+                        printf("%s: call %ld at (%d, %d) decided %d instead of %d\n", argv[m], log->frames,
+                            frame->x, frame->y, d, frame->decision);
+                    }
+
+                    differing++;
+                }
+            }
+
+            if (!feof(log->f))
+                fprintf(stderr, "%s is truncated after %ld calls\n", argv[m], log->frames);
+
+            for (int j = 0; j < h; j++)
+                free(map[j]);
+
+            free(map);
+            record_close(log);
+        }
+
+        qsort(times, calls, sizeof(double), by_time);
+
+        printf("%-24s %8ld %7ld %10ld %12.0f %6.2f us %6.2f us %6.2f us %6.2f us\n", argv[m], calls, games, differing,
+            total > 0 ? calls / (total / 1e9) : 0, calls > 0 ? total / calls / 1e3 : 0,
+            calls > 0 ? times[calls / 2] / 1e3 : 0, calls > 0 ? times[(long)floor(calls * 0.99)] / 1e3 : 0,
+            calls > 0 ? times[calls - 1] / 1e3 : 0);
+
+        if (extra_draws > 0)
+            printf("%s: %ld draws of rand beyond the recorded ones\n", argv[m], extra_draws);
+
+        differing_files += differing > 0;
+        free(times);
+    }
+
+    return differing_files > 0;
+}
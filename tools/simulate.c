@@ -0,0 +1,102 @@
+// Play complete games with the pacman function, following the rules of the game engine
+// but without displaying them or waiting between the rounds, and report how fast the
+// games are played, how many are won, and the scores.
+//
+//     make simulate
+//     tools/simulate [-n games] [-s seed] [-l max rounds] [-m easy|original] <file>...
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "../player.c"
+#define PACMAN_H // Included by player.c
+#include "simulator.h"
+#include "map_loader.h"
+#include "common.h"
+
+#include <math.h>
+
+#define DEFAULT_GAMES 100
+#define DEFAULT_MAX_ROUNDS 10000 // The game engine has no limit, but a game could go on forever
+
+int main(int argc, char *argv[])
+{
+    int games = DEFAULT_GAMES;
+    unsigned int seed = 1;
+    long max_rounds = DEFAULT_MAX_ROUNDS;
+    bool original = false;
+    int first_file = argc;
+
+    for (int i = 1; i < argc && first_file == argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            games = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-l") && i + 1 < argc)
+            max_rounds = atol(argv[++i]);
+        else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+            original = !strcmp(argv[++i], "original");
+        else
+            first_file = i;
+    }
+
+    if (games < 1 || first_file == argc)
+    {
+        fprintf(stderr, "%s [-n games] [-s seed] [-l max rounds] [-m easy|original] <file>...\n", argv[0]);
+        return 1;
+    }
+
+    printf("%-12s %6s %9s %12s %6s %9s %9s %6s %6s %6s %6s %6s %7s\n", "map", "games", "games/s", "decisions/s",
+        "won", "score", "stddev", "wall", "eaten", "stuck", "limit", "abort", "rounds");
+
+    for (int m = first_file; m < argc; m++)
+    {
+        FILE* f = fopen(argv[m], "r");
+        if (!f)
+        {
+            fprintf(stderr, "could not open file %s for reading\n", argv[m]);
+            return 1;
+        }
+
+        int w, h;
+        char** map = create_map(f, &w, &h);
+
+        long outcomes[SIM_ABORTED + 1] = {0};
+        long rounds = 0;
+        double total = 0, squares = 0;
+        double start = now();
+
+        for (int i = 0; i < games; i++)
+        {
+            // One seed per game, as the game engine seeds the generator once per game.
+            sim_game* game = sim_create(map, w, h, original);
+            if (!game)
+            {
+                fprintf(stderr, "%s lacks Pacman, a ghost or their door\n", argv[m]);
+                return 1;
+            }
+
+            srand(seed + i);
+            outcomes[sim_play(game, max_rounds)]++;
+
+            rounds += game->rounds;
+            total += game->score;
+            squares += (double)game->score * game->score;
+
+            sim_destroy(game);
+        }
+
+        double elapsed = (now() - start) / 1e9;
+        double mean = total / games;
+        double stddev = games > 1 ? sqrt((squares - games * mean * mean) / (games - 1)) : 0;
+
+        printf("%-12s %6d %9.1f %12.0f %5.1f%% %9.1f %9.1f %6ld %6ld %6ld %6ld %6ld %7.1f\n", argv[m], games,
+            games / elapsed, rounds / elapsed, 100.0 * outcomes[SIM_WON] / games, mean, stddev,
+            outcomes[SIM_WALL], outcomes[SIM_EATEN], outcomes[SIM_STUCK], outcomes[SIM_TIMEOUT],
+            outcomes[SIM_ABORTED], (double)rounds / games);
+
+        destroy_map(map, w, h);
+    }
+
+    return 0;
+}
@@ -0,0 +1,474 @@
+// The rules of the game engine (pacman.o), reimplemented so that games can be played
+// without a terminal: Pacman moves first, then each ghost, until Pacman wins, is eaten,
+// is stuck, or bumps into a wall. The calls to rand are made in the same order as the
+// game engine makes them, so that a game only depends on the seed given to srand.
+
+#include "simulator.h"
+#include "common.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char DEAD_PACMAN = '_';
+
+#define ENERGY_MODE_ROUNDS 100
+#define GHOST_BONUS 200
+#define TARGET_STEPS 10 // How far ahead of, or behind, Pacman the second and third ghosts aim
+
+static bool is_ghost(char c)
+{
+    return c == GHOST1 || c == GHOST2 || c == GHOST3 || c == GHOST4;
+}
+
+static direction opposite(direction d)
+{
+    return (direction)((d + 2) % 4);
+}
+
+// Move one step, going through the borders of the map to the other side.
+static void step(const sim_game* game, int* x, int* y, direction d)
+{
+    switch (d)
+    {
+    case NORTH:
+        *y = *y > 0 ? *y - 1 : game->h - 1;
+        break;
+    case EAST:
+        *x = *x < game->w - 1 ? *x + 1 : 0;
+        break;
+    case SOUTH:
+        *y = *y < game->h - 1 ? *y + 1 : 0;
+        break;
+    default: // Any other value moves west, as in the game engine
+        *x = *x > 0 ? *x - 1 : game->w - 1;
+        break;
+    }
+}
+
+// The ghosts go through their door in one move, without coming back through the borders.
+static bool step_through_door(const sim_game* game, int* x, int* y, direction d)
+{
+    const int dx[4] = {0, 1, 0, -1}, dy[4] = {-1, 0, 1, 0};
+
+    if (game->map[*y][*x] != DOOR)
+        return true;
+
+    *x += dx[d];
+    *y += dy[d];
+
+    return *x >= 0 && *x < game->w && *y >= 0 && *y < game->h;
+}
+
+static bool can_go(const sim_game* game, char c, int x, int y, direction d)
+{
+    step(game, &x, &y, d);
+
+    if (is_ghost(c) && !step_through_door(game, &x, &y, d))
+        return false;
+
+    char target = game->map[y][x];
+
+    return target == PATH || target == VIRGIN_PATH || target == ENERGY
+        || (target == PACMAN && !game->energy)
+        || (c == PACMAN && is_ghost(target));
+}
+
+static int possible_moves(const sim_game* game, char c, int x, int y, bool can[4])
+{
+    int count = 0;
+
+    for (int d = NORTH; d <= WEST; d++)
+        count += can[d] = can_go(game, c, x, y, d);
+
+    return count;
+}
+
+// Whether a ghost sees Pacman in a direction: the look stops at the walls and at the
+// borders of the map.
+static bool sees_pacman(const sim_game* game, const sim_ghost* ghost, direction d)
+{
+    const int dx[4] = {0, 1, 0, -1}, dy[4] = {-1, 0, 1, 0};
+    int x = ghost->x, y = ghost->y;
+
+    while (x >= 0 && x < game->w && y >= 0 && y < game->h && game->map[y][x] != WALL)
+    {
+        if (game->map[y][x] == PACMAN)
+            return true;
+
+        x += dx[d];
+        y += dy[d];
+    }
+
+    return false;
+}
+
+// The fourth ghost, and all of them outside of the original mode: it rushes at Pacman
+// when it sees it, follows the corridors, and picks a random way at the crossings.
+static direction wander(const sim_game* game, const sim_ghost* ghost, const bool can[4], int count)
+{
+    bool sees[4];
+    direction d;
+
+    for (d = NORTH; d <= WEST; d++)
+        sees[d] = sees_pacman(game, ghost, d);
+
+    for (d = NORTH; d <= WEST; d++)
+    {
+        if (can[d] && !game->energy && sees[d])
+            return d;
+    }
+
+    if (count == 2)
+    {
+        if ((int)ghost->last >= 0 && can[ghost->last] && !(sees[ghost->last] && game->energy))
+            return ghost->last;
+
+        for (d = NORTH; d <= WEST; d++)
+        {
+            if (can[d] && ghost->last != opposite(d) && !(sees[d] && game->energy))
+                return d;
+        }
+    }
+
+    // The game engine draws until it gets a way that does not lead to Pacman in energy
+    // mode. When a ghost ends up on the position of Pacman, which happens when Pacman
+    // eats it on its starting position, it sees Pacman every way, and the game engine
+    // would draw forever.
+    bool drawable = false;
+
+    for (d = NORTH; d <= WEST; d++)
+        drawable |= can[d] && !(sees[d] && game->energy && count != 1);
+
+    if (!drawable)
+        return (direction)-1;
+
+    do
+        d = (direction)(rand() % 4);
+    while (!can[d] || (sees[d] && game->energy && count != 1));
+
+    return d;
+}
+
+// The first three ghosts of the original mode: they head for a target, and flee from it
+// in energy mode once they are close.
+static direction chase(const sim_game* game, const sim_ghost* ghost, const bool can[4], int count, int tx, int ty)
+{
+    // Orders of preference, by where the target is and along which axis it is the
+    // farthest away.
+    static const direction orders[8][4] = {
+        {NORTH, EAST, WEST, SOUTH}, {EAST, NORTH, SOUTH, WEST}, // North-east of the ghost
+        {SOUTH, EAST, WEST, NORTH}, {EAST, SOUTH, NORTH, WEST}, // South-east
+        {SOUTH, WEST, EAST, NORTH}, {WEST, SOUTH, NORTH, EAST}, // South-west
+        {NORTH, WEST, EAST, SOUTH}, {WEST, NORTH, SOUTH, EAST}, // North-west
+    };
+    direction order[4];
+    direction d;
+
+    for (d = NORTH; d <= WEST; d++)
+    {
+        if (can[d] && !game->energy && sees_pacman(game, ghost, d))
+            return d;
+    }
+
+    int radius = (int)(sqrt(pow(game->w, 2.0) + pow(game->h, 2.0)) / 4.0);
+    int dx = ghost->x - tx, dy = ghost->y - ty;
+    int distance = (int)sqrt(pow(dx, 2.0) + pow(dy, 2.0));
+    int quadrant;
+
+    if (dx <= 0 && dy > 0)
+        quadrant = 0;
+    else if (dx < 0 && dy <= 0)
+        quadrant = 1;
+    else if (dx >= 0 && dy < 0)
+        quadrant = 2;
+    else
+        quadrant = 3;
+
+    bool flee = game->energy && distance <= radius;
+    const direction* preferred = orders[2 * quadrant + (abs(dx) - abs(dy) >= 0)];
+
+    for (int i = 0; i < 4; i++)
+        order[i] = flee ? opposite(preferred[i]) : preferred[i];
+
+    if ((int)ghost->last < 0 || !can[ghost->last] || count > 2 || flee)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            if (can[order[i]])
+                return order[i];
+        }
+    }
+
+    return ghost->last;
+}
+
+static bool locate(char** map, int w, int h, char c, int* x, int* y)
+{
+    for (*y = 0; *y < h; (*y)++)
+    {
+        for (*x = 0; *x < w; (*x)++)
+        {
+            if (map[*y][*x] == c)
+                return true;
+        }
+    }
+
+    return false;
+}
+
+static direction ghost_direction(const sim_game* game, int i, const bool can[4], int count)
+{
+    const sim_ghost* ghost = &game->ghosts[i];
+    int tx = game->x, ty = game->y;
+
+    if (!game->original || i == 3)
+        return wander(game, ghost, can, count);
+
+    // The ghosts look for Pacman on the map, where a ghost sent back home could have
+    // been drawn over it: the search then ends past the last position.
+    bool found = game->map[ty][tx] == PACMAN || locate(game->map, game->w, game->h, PACMAN, &tx, &ty);
+
+    // The second ghost aims ahead of Pacman, the third one behind it.
+    if (i > 0 && (int)game->last >= 0 && game->last <= WEST)
+    {
+        direction d = i == 1 ? game->last : opposite(game->last);
+
+        // Going north or west from past the last position, the game engine reads
+        // outside of the map.
+        if (!found && (d == NORTH || d == WEST))
+            return (direction)-1;
+
+        for (int k = 0; k < TARGET_STEPS; k++)
+        {
+            if (d == NORTH && ty > 0)
+                ty--;
+            else if (d == EAST && tx < game->w - 1)
+                tx++;
+            else if (d == SOUTH && ty < game->h - 1)
+                ty++;
+            else if (d == WEST && tx > 0)
+                tx--;
+        }
+    }
+
+    return chase(game, ghost, can, count, tx, ty);
+}
+
+static bool pellets_left(const sim_game* game)
+{
+    for (int y = 0; y < game->h; y++)
+    {
+        if (memchr(game->map[y], VIRGIN_PATH, game->w) || memchr(game->map[y], ENERGY, game->w))
+            return true;
+    }
+
+    return false;
+}
+
+static void free_rows(char** map, int h)
+{
+    if (!map)
+        return;
+
+    for (int y = 0; y < h; y++)
+        free(map[y]);
+
+    free(map);
+}
+
+static char** copy_rows(char** map, int w, int h)
+{
+    char** copy = malloc(h * sizeof(char*));
+
+    for (int y = 0; y < h; y++)
+    {
+        copy[y] = malloc(w);
+        memcpy(copy[y], map[y], w);
+    }
+
+    return copy;
+}
+
+// ***********************************************************************************
+// Simulation
+// ***********************************************************************************
+
+sim_game* sim_create(char** map, int w, int h, bool original)
+{
+    const char ghosts[4] = {GHOST1, GHOST2, GHOST3, GHOST4};
+    sim_game* game = calloc(1, sizeof(sim_game));
+    int x, y;
+
+    game->w = w;
+    game->h = h;
+    game->last = (direction)-1;
+    game->bonus = GHOST_BONUS;
+    game->original = original;
+    game->outcome = SIM_PLAYING;
+
+    // The game engine does not start without Pacman, the ghosts and their door.
+    bool found = locate(map, w, h, PACMAN, &game->x, &game->y);
+
+    for (int i = 0; i < 4; i++)
+    {
+        sim_ghost* ghost = &game->ghosts[i];
+
+        found = found && locate(map, w, h, ghosts[i], &ghost->x, &ghost->y);
+        ghost->c = ghosts[i];
+        ghost->start_x = ghost->x;
+        ghost->start_y = ghost->y;
+        ghost->last = (direction)-1;
+        ghost->under = PATH;
+    }
+
+    if (!found || !locate(map, w, h, DOOR, &x, &y))
+    {
+        free(game);
+        return NULL;
+    }
+
+    game->map = copy_rows(map, w, h);
+    game->copy = copy_rows(map, w, h);
+
+    return game;
+}
+
+void sim_destroy(sim_game* game)
+{
+    if (!game)
+        return;
+
+    free_rows(game->map, game->h);
+    free_rows(game->copy, game->h);
+    free(game);
+}
+
+sim_outcome sim_step(sim_game* game)
+{
+    bool can[4];
+    bool invalid = false, eaten = false, stuck = false, won = false;
+
+    if (game->outcome != SIM_PLAYING)
+        return game->outcome;
+
+    if (game->energy && --game->energy_rounds <= 0)
+    {
+        game->energy = false;
+        game->energy_rounds = ENERGY_MODE_ROUNDS;
+        game->bonus = GHOST_BONUS;
+    }
+
+    if (possible_moves(game, PACMAN, game->x, game->y, can) > 0)
+    {
+        // The pacman function is given a copy of the map, as by the game engine.
+        for (int y = 0; y < game->h; y++)
+            memcpy(game->copy[y], game->map[y], game->w);
+
+        game->last = pacman(game->copy, game->w, game->h, game->x, game->y, game->last, game->energy, game->energy_rounds);
+        invalid = (int)game->last < 0 || game->last > WEST || !can[game->last];
+
+        game->map[game->y][game->x] = PATH;
+        step(game, &game->x, &game->y, game->last);
+        char under = game->map[game->y][game->x];
+        game->map[game->y][game->x] = PACMAN;
+
+        if (under == VIRGIN_PATH)
+            game->score += VIRGIN_PATH_SCORE;
+        else if (under == ENERGY)
+        {
+            game->score += ENERGY_SCORE;
+            game->energy = true;
+            game->energy_rounds = ENERGY_MODE_ROUNDS;
+            game->bonus = GHOST_BONUS;
+        }
+        else if (is_ghost(under) && !game->energy)
+        {
+            game->map[game->y][game->x] = DEAD_PACMAN;
+            eaten = true;
+        }
+        else if (is_ghost(under))
+        {
+            // The ghost goes back home, and whatever it walked over is lost.
+            sim_ghost* ghost = &game->ghosts[under == GHOST1 ? 0 : under == GHOST2 ? 1 : under == GHOST3 ? 2 : 3];
+
+            game->score += game->bonus;
+            game->bonus = (int)((unsigned int)game->bonus * 2); // Wraps around, as in the game engine
+            game->map[ghost->start_y][ghost->start_x] = ghost->c;
+            ghost->x = ghost->start_x;
+            ghost->y = ghost->start_y;
+            ghost->under = PATH;
+        }
+        else
+            won = !pellets_left(game);
+    }
+    else
+        stuck = true;
+
+    for (int i = 0; i < 4; i++)
+    {
+        sim_ghost* ghost = &game->ghosts[i];
+
+        // Bumping into a wall only stops the first ghost, as in the game engine.
+        if (eaten || won || stuck || (i == 0 && invalid) || (game->energy && !game->toggle))
+            continue;
+
+        int count = possible_moves(game, ghost->c, ghost->x, ghost->y, can);
+
+        if (count == 0)
+            continue;
+
+        ghost->last = ghost_direction(game, i, can, count);
+
+        // No direction: the game engine would not get past this move.
+        if ((int)ghost->last < 0)
+        {
+            game->rounds++;
+            return game->outcome = SIM_ABORTED;
+        }
+
+        game->map[ghost->y][ghost->x] = ghost->under;
+        step(game, &ghost->x, &ghost->y, ghost->last);
+        step_through_door(game, &ghost->x, &ghost->y, ghost->last);
+        ghost->under = game->map[ghost->y][ghost->x];
+        game->map[ghost->y][ghost->x] = ghost->c;
+
+        if (ghost->under == PACMAN && !game->energy)
+        {
+            game->map[ghost->y][ghost->x] = DEAD_PACMAN;
+            eaten = true;
+        }
+    }
+
+    game->toggle = !game->toggle;
+    game->rounds++;
+
+    if (invalid)
+        game->outcome = SIM_WALL;
+    else if (eaten)
+        game->outcome = SIM_EATEN;
+    else if (stuck)
+        game->outcome = SIM_STUCK;
+    else if (won)
+        game->outcome = SIM_WON;
+
+    return game->outcome;
+}
+
+sim_outcome sim_play(sim_game* game, long max_rounds)
+{
+    while (sim_step(game) == SIM_PLAYING)
+    {
+        if (max_rounds > 0 && game->rounds >= max_rounds)
+            return game->outcome = SIM_TIMEOUT;
+    }
+
+    return game->outcome;
+}
+
+const char* sim_outcome_name(sim_outcome outcome)
+{
+    static const char* const names[] = {"playing", "won", "wall", "eaten", "stuck", "timeout", "aborted"};
+
+    return names[outcome];
+}
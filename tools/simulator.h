@@ -0,0 +1,96 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stdbool.h>
+
+// pacman.h has no include guard: a file which includes it already, as player.c does,
+// defines PACMAN_H before including this header.
+#ifndef PACMAN_H
+#include "../pacman.h"
+#endif
+
+// The way a game ended, in the order the game engine reports them: bumping into a wall
+// is reported before being eaten, which is reported before being stuck.
+typedef enum
+{
+    SIM_PLAYING,
+    SIM_WON,
+    SIM_WALL, // Pacman bumped into a wall
+    SIM_EATEN, // Pacman was eaten by a ghost
+    SIM_STUCK, // Pacman could not move anymore
+    SIM_TIMEOUT, // The game lasted more rounds than allowed
+    SIM_ABORTED // The game engine would hang or crash, after drawing a ghost over Pacman
+} sim_outcome;
+
+// A ghost, with what it walks over, which is put back on the map when it leaves.
+typedef struct
+{
+    char c;
+    int x, y;
+    int start_x, start_y;
+    direction last;
+    char under;
+} sim_ghost;
+
+// A game in progress, played with the rules of the game engine, without displaying
+// anything or waiting between two rounds.
+typedef struct
+{
+    char** map;
+    char** copy; // The map given to the pacman function, which could write into it
+    int w, h;
+
+    int x, y; // Pacman
+    direction last;
+    sim_ghost ghosts[4];
+
+    bool energy;
+    int energy_rounds; // The rounds left in energy mode, as given to the pacman function
+    int bonus; // The points earned by eating the next ghost
+    bool toggle; // In energy mode, the ghosts only move every other round
+    bool original; // The ghosts chase Pacman, instead of wandering randomly
+
+    long score;
+    long rounds;
+    sim_outcome outcome;
+} sim_game;
+
+/**
+ * @brief Start a game on a copy of a map
+ * @param map The map, which must hold Pacman, the four ghosts and their door
+ * @param w The width of the map
+ * @param h The height of the map
+ * @param original Whether the ghosts behave as in the original game (-mode original)
+ * @return The game, NULL if the map lacks one of the entities
+ */
+sim_game* sim_create(char** map, int w, int h, bool original);
+
+/**
+ * @brief Release a game
+ * @param game The game
+ */
+void sim_destroy(sim_game* game);
+
+/**
+ * @brief Play a round: Pacman moves, then each ghost
+ * @param game The game
+ * @return The outcome of the game, SIM_PLAYING if it goes on
+ */
+sim_outcome sim_step(sim_game* game);
+
+/**
+ * @brief Play a game until it ends
+ * @param game The game
+ * @param max_rounds The rounds after which the game is stopped, 0 for no limit
+ * @return The outcome of the game
+ */
+sim_outcome sim_play(sim_game* game, long max_rounds);
+
+/**
+ * @brief Name an outcome
+ * @param outcome The outcome
+ * @return Its name
+ */
+const char* sim_outcome_name(sim_outcome outcome);
+
+#endif // SIMULATOR_H
@@ -0,0 +1,282 @@
+// Play many seeded games on each level with the simulator, shared between as many worker
+// processes as there are processors, and sum the results up per level: scores, moves,
+// how the games ended, and how long the rounds took. The pacman function keeps state
+// between its calls, and is not meant to be called from several threads: the workers
+// are processes, which take the next game from a counter in shared memory.
+//
+// Each game is appended to the results as a line of pacman.csv, followed by its seed,
+// its number of moves, how it ended and the mean time of its rounds:
+//
+//     binome,map,score,seed,moves,outcome,round_us
+//
+//     make tournament
+//     tools/tournament [-n games] [-j workers] [-s seed] [-l max rounds] [-m easy|original] [-o results.csv] <file>...
+//
+// Game i of a level is played with the seed s + i, as by tools/simulate, whatever the
+// number of workers.
+
+#define _DEFAULT_SOURCE
+
+#include "../player.c"
+#define PACMAN_H // Included by player.c
+#include "simulator.h"
+#include "map_loader.h"
+#include "common.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define DEFAULT_GAMES 1000
+#define DEFAULT_MAX_ROUNDS 10000 // As tools/simulate
+#define MAX_MAPS 16
+
+// The times of the rounds are counted per microsecond, up to this many.
+#define LATENCY_BUCKETS 10000
+
+// A game, as written by the worker which played it.
+typedef struct
+{
+    long score;
+    long rounds;
+    sim_outcome outcome;
+    double round_ns; // The mean time of a round, which the decision of Pacman dominates
+} game_result;
+
+// The memory shared by the workers and the parent process.
+typedef struct
+{
+    atomic_long next; // The next game to play, over all the levels
+    atomic_long latencies[MAX_MAPS][LATENCY_BUCKETS + 1]; // The last bucket takes the longer rounds
+    game_result games[]; // Level after level
+} tournament;
+
+typedef struct
+{
+    const char* name;
+    char** map;
+    int w, h;
+} level;
+
+// Play games until there are none left, then add the times of the rounds to the shared
+// counts.
+static void work(tournament* t, const level* levels, int level_count, int games, unsigned int seed,
+    long max_rounds, bool original)
+{
+    long (*latencies)[LATENCY_BUCKETS + 1] = calloc(level_count, sizeof(*latencies));
+    long game;
+
+    while ((game = atomic_fetch_add(&t->next, 1)) < (long)level_count * games)
+    {
+        int l = game / games;
+        sim_game* g = sim_create(levels[l].map, levels[l].w, levels[l].h, original);
+        double total = 0;
+
+        srand(seed + game % games);
+
+        while (g->outcome == SIM_PLAYING)
+        {
+            double start = now();
+
+            sim_step(g);
+
+            double elapsed = now() - start;
+            long us = (long)(elapsed / 1000);
+
+            latencies[l][us < LATENCY_BUCKETS ? us : LATENCY_BUCKETS]++;
+            total += elapsed;
+
+            if (g->outcome == SIM_PLAYING && max_rounds > 0 && g->rounds >= max_rounds)
+                g->outcome = SIM_TIMEOUT;
+        }
+
+        game_result* r = &t->games[game];
+        r->score = g->score;
+        r->rounds = g->rounds;
+        r->outcome = g->outcome;
+        r->round_ns = g->rounds > 0 ? total / g->rounds : 0;
+
+        sim_destroy(g);
+    }
+
+    for (int l = 0; l < level_count; l++)
+    {
+        for (int b = 0; b <= LATENCY_BUCKETS; b++)
+        {
+            if (latencies[l][b] > 0)
+                atomic_fetch_add(&t->latencies[l][b], latencies[l][b]);
+        }
+    }
+
+    free(latencies);
+}
+
+// The time under which a share of the rounds were played, in microseconds.
+static long percentile(const atomic_long* latencies, long count, int percent)
+{
+    long seen = 0;
+
+    for (int b = 0; b < LATENCY_BUCKETS; b++)
+    {
+        seen += latencies[b];
+
+        if (seen * 100 >= count * percent)
+            return b;
+    }
+
+    return LATENCY_BUCKETS;
+}
+
+int main(int argc, char *argv[])
+{
+    int games = DEFAULT_GAMES;
+    int workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int seed = 1;
+    long max_rounds = DEFAULT_MAX_ROUNDS;
+    bool original = false;
+    const char* output = "tournament.csv";
+    level levels[MAX_MAPS];
+    int level_count = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            games = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+            workers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-l") && i + 1 < argc)
+            max_rounds = atol(argv[++i]);
+        else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+            original = !strcmp(argv[++i], "original");
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            output = argv[++i];
+        else if (level_count < MAX_MAPS)
+            levels[level_count++].name = argv[i];
+    }
+
+    if (games < 1 || workers < 1 || level_count == 0)
+    {
+        fprintf(stderr, "%s [-n games] [-j workers] [-s seed] [-l max rounds] [-m easy|original] [-o results.csv] <file>...\n", argv[0]);
+        return 1;
+    }
+
+    for (int l = 0; l < level_count; l++)
+    {
+        FILE* f = fopen(levels[l].name, "r");
+        if (!f)
+        {
+            fprintf(stderr, "could not open file %s for reading\n", levels[l].name);
+            return 1;
+        }
+
+        levels[l].map = create_map(f, &levels[l].w, &levels[l].h);
+
+        sim_game* g = sim_create(levels[l].map, levels[l].w, levels[l].h, original);
+        if (!g)
+        {
+            fprintf(stderr, "%s lacks Pacman, a ghost or their door\n", levels[l].name);
+            return 1;
+        }
+
+        sim_destroy(g);
+    }
+
+    // The workers inherit the levels, and write the games into the shared memory.
+    size_t size = sizeof(tournament) + (size_t)level_count * games * sizeof(game_result);
+    tournament* t = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (t == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    double start = now();
+
+    for (int w = 0; w < workers; w++)
+    {
+        pid_t pid = fork();
+
+        if (pid < 0)
+        {
+            perror("fork");
+            return 1;
+        }
+
+        if (pid == 0)
+        {
+            work(t, levels, level_count, games, seed, max_rounds, original);
+            _exit(0);
+        }
+    }
+
+    int status, failed = 0;
+
+    while (wait(&status) > 0)
+        failed += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+
+    double elapsed = (now() - start) / 1e9;
+
+    if (failed > 0 || atomic_load(&t->next) < (long)level_count * games)
+    {
+        fprintf(stderr, "%d worker(s) failed, the results are incomplete\n", failed);
+        return 1;
+    }
+
+    // The games are appended to the results, as pacman.csv is by the game engine.
+    FILE* f = fopen(output, "a");
+    if (!f)
+    {
+        fprintf(stderr, "could not open file %s for writing\n", output);
+        return 1;
+    }
+
+    printf("%-12s %6s %6s %9s %9s %7s %6s %6s %6s %6s %6s %9s %7s %7s\n", "map", "games", "won", "score", "stddev",
+        "moves", "wall", "eaten", "stuck", "limit", "abort", "round", "p50", "p99");
+
+    long total_rounds = 0;
+
+    for (int l = 0; l < level_count; l++)
+    {
+        long outcomes[SIM_ABORTED + 1] = {0};
+        long rounds = 0;
+        double total = 0, squares = 0, time = 0;
+
+        for (int i = 0; i < games; i++)
+        {
+            const game_result* r = &t->games[(long)l * games + i];
+
+            fprintf(f, "%s,%s,%ld,%u,%ld,%s,%.1f\n", binome, levels[l].name, r->score, seed + i, r->rounds,
+                sim_outcome_name(r->outcome), r->round_ns / 1e3);
+
+            outcomes[r->outcome]++;
+            rounds += r->rounds;
+            total += r->score;
+            squares += (double)r->score * r->score;
+            time += r->round_ns * r->rounds;
+        }
+
+        double mean = total / games;
+        double stddev = games > 1 ? sqrt(fmax(0, squares - games * mean * mean) / (games - 1)) : 0;
+
+        printf("%-12s %6d %5.1f%% %9.1f %9.1f %7.1f %6ld %6ld %6ld %6ld %6ld %6.1f us %4ld us %4ld us\n",
+            levels[l].name, games, 100.0 * outcomes[SIM_WON] / games, mean, stddev, (double)rounds / games,
+            outcomes[SIM_WALL], outcomes[SIM_EATEN], outcomes[SIM_STUCK], outcomes[SIM_TIMEOUT],
+            outcomes[SIM_ABORTED], rounds > 0 ? time / rounds / 1e3 : 0,
+            percentile(t->latencies[l], rounds, 50), percentile(t->latencies[l], rounds, 99));
+
+        total_rounds += rounds;
+        destroy_map(levels[l].map, levels[l].w, levels[l].h);
+    }
+
+    fclose(f);
+
+    printf("\n%ld games and %ld rounds in %.2f s with %d workers: %.1f games/s, %.0f rounds/s\n",
+        (long)level_count * games, total_rounds, elapsed, workers, level_count * games / elapsed, total_rounds / elapsed);
+
+    munmap(t, size);
+
+    return 0;
+}
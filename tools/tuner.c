@@ -0,0 +1,380 @@
+// Tune the parameters of the strategy for each level, by playing seeded games with the
+// simulator. Candidate parameters are drawn at random around the ranges that make sense,
+// alongside the default ones, and compared by successive halving: every candidate plays a
+// few games, the better half goes on and plays twice as many, and so on until a single one
+// is left. Most of the games are thus played by the promising candidates.
+//
+// The games are shared between as many worker processes as there are processors, as by
+// tools/tournament. All the candidates play the same seeds, so that they are compared on
+// the same games; the games played in a round are kept for the next one.
+//
+//     make tune
+//     tools/tuner [-c candidates] [-n games] [-j workers] [-s seed] [-r random seed] [-l max rounds] [-m easy|original] <file>...
+
+#define _DEFAULT_SOURCE
+
+#include "../player.c"
+#define PACMAN_H // Included by player.c
+#include "simulator.h"
+#include "map_loader.h"
+#include "common.h"
+
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define DEFAULT_CANDIDATES 32
+#define DEFAULT_GAMES 8 // Played by every candidate in the first round
+#define DEFAULT_MAX_ROUNDS 10000 // As tools/simulate
+
+// A candidate, and the games it played so far.
+typedef struct
+{
+    strategy_parameters p;
+    long games;
+    long won;
+    double total; // The sum of the scores
+    long* scores; // The scores, seed after seed
+    long median;
+    bool alive; // Still in the running
+} candidate;
+
+// A game to play, and its result once played.
+typedef struct
+{
+    int candidate;
+    unsigned int seed;
+    long score;
+    sim_outcome outcome;
+} job;
+
+// The memory shared by the workers and the parent process, for one round.
+typedef struct
+{
+    atomic_long next; // The next job to play
+    job jobs[];
+} batch;
+
+// A generator of its own, so that the candidates do not depend on the games played.
+static unsigned long long random_state = 42;
+
+static unsigned int next_random(void)
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+
+    return (unsigned int)(random_state >> 32);
+}
+
+static int random_between(int low, int high)
+{
+    return low + (int)(next_random() % (unsigned int)(high - low + 1));
+}
+
+// Draw parameters in the ranges the game allows: the energy mode lasts 99 rounds, and the
+// weights fit the graph edges.
+static strategy_parameters random_parameters(void)
+{
+    strategy_parameters p;
+
+    p.ghost_chasing_threshold = random_between(0, 99);
+    p.ghost_proximity_threshold = random_between(1, 4);
+    p.ghost_near_radius = random_between(1, 12);
+    p.chase_energizer_weight = (unsigned char)random_between(1, 200);
+    p.flee_ghost_weight = (unsigned char)random_between(1, 200);
+    p.pellet_energizer_weight = (unsigned char)random_between(1, 200);
+    p.pellet_ghost_weight = (unsigned char)random_between(1, 200);
+
+    return p;
+}
+
+static double mean(const candidate* c)
+{
+    return c->games > 0 ? c->total / c->games : 0;
+}
+
+// Play jobs until there are none left, with the parameters of their candidate.
+static void work(batch* b, long count, const candidate* candidates, char** map, int w, int h,
+    long max_rounds, bool original)
+{
+    long i;
+
+    while ((i = atomic_fetch_add(&b->next, 1)) < count)
+    {
+        job* j = &b->jobs[i];
+        sim_game* g = sim_create(map, w, h, original);
+
+        strategy = candidates[j->candidate].p;
+        srand(j->seed);
+
+        j->outcome = sim_play(g, max_rounds);
+        j->score = g->score;
+
+        sim_destroy(g);
+    }
+}
+
+// Play the jobs with the workers, and wait for them. Returns false if one of them failed.
+static bool play(batch* b, long count, int workers, const candidate* candidates, char** map, int w, int h,
+    long max_rounds, bool original)
+{
+    int status, failed = 0;
+
+    atomic_store(&b->next, 0);
+
+    for (int i = 0; i < workers; i++)
+    {
+        pid_t pid = fork();
+
+        if (pid < 0)
+        {
+            perror("fork");
+            return false;
+        }
+
+        if (pid == 0)
+        {
+            work(b, count, candidates, map, w, h, max_rounds, original);
+            _exit(0);
+        }
+    }
+
+    while (wait(&status) > 0)
+        failed += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+
+    return failed == 0 && atomic_load(&b->next) >= count;
+}
+
+static int by_score(const void* a, const void* b)
+{
+    long sa = *(const long*)a, sb = *(const long*)b;
+
+    return (sa > sb) - (sa < sb);
+}
+
+// Order the candidates by decreasing median score, then by decreasing share of games won.
+// A few ghosts eaten in a row score more than a whole level, as the bonus doubles: the
+// mean score would follow the luckiest games.
+static int by_results(const void* a, const void* b)
+{
+    const candidate* ca = *(candidate* const*)a;
+    const candidate* cb = *(candidate* const*)b;
+
+    if (ca->median != cb->median)
+        return (ca->median < cb->median) - (ca->median > cb->median);
+
+    return (ca->won < cb->won) - (ca->won > cb->won);
+}
+
+static void print_parameters(const strategy_parameters* p)
+{
+    printf("chasing %2d, proximity %d, radius %2d, weights %3d %3d %3d %3d",
+        p->ghost_chasing_threshold, p->ghost_proximity_threshold, p->ghost_near_radius,
+        p->chase_energizer_weight, p->flee_ghost_weight, p->pellet_energizer_weight, p->pellet_ghost_weight);
+}
+
+int main(int argc, char *argv[])
+{
+    int count = DEFAULT_CANDIDATES;
+    int games = DEFAULT_GAMES;
+    int workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int seed = 1;
+    long max_rounds = DEFAULT_MAX_ROUNDS;
+    bool original = false;
+    int first_file = argc;
+
+    for (int i = 1; i < argc && first_file == argc; i++)
+    {
+        if (!strcmp(argv[i], "-c") && i + 1 < argc)
+            count = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            games = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+            workers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+            random_state = strtoull(argv[++i], NULL, 10) | 1;
+        else if (!strcmp(argv[i], "-l") && i + 1 < argc)
+            max_rounds = atol(argv[++i]);
+        else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+            original = !strcmp(argv[++i], "original");
+        else
+            first_file = i;
+    }
+
+    if (count < 1 || games < 1 || workers < 1 || first_file == argc)
+    {
+        fprintf(stderr, "%s [-c candidates] [-n games] [-j workers] [-s seed] [-r random seed] [-l max rounds] [-m easy|original] <file>...\n", argv[0]);
+        return 1;
+    }
+
+    // The first candidate keeps the default parameters, to tell how much the others gain.
+    strategy_parameters defaults = strategy;
+    candidate* candidates = malloc(count * sizeof(candidate));
+    candidate** ranking = malloc(count * sizeof(candidate*));
+
+    // The last round plays the most games per candidate, for the two candidates left;
+    // each round after the first one plays, per candidate left, as many new games as
+    // were played before. No round is played once a single candidate is left.
+    long most_games = games;
+    long most_jobs = (long)count * games;
+
+    for (int left = (count + 1) / 2; left > 1; left = (left + 1) / 2)
+    {
+        if ((long)left * most_games > most_jobs)
+            most_jobs = (long)left * most_games;
+
+        most_games *= 2;
+    }
+
+    long* sorted = malloc(most_games * sizeof(long));
+
+    for (int c = 0; c < count; c++)
+        candidates[c].scores = malloc(most_games * sizeof(long));
+
+    size_t size = sizeof(batch) + (size_t)most_jobs * sizeof(job);
+    batch* b = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (b == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    for (int m = first_file; m < argc; m++)
+    {
+        FILE* f = fopen(argv[m], "r");
+        if (!f)
+        {
+            fprintf(stderr, "could not open file %s for reading\n", argv[m]);
+            return 1;
+        }
+
+        int w, h;
+        char** map = create_map(f, &w, &h);
+
+        sim_game* g = sim_create(map, w, h, original);
+        if (!g)
+        {
+            fprintf(stderr, "%s lacks Pacman, a ghost or their door\n", argv[m]);
+            return 1;
+        }
+
+        sim_destroy(g);
+
+        // Every level draws its own candidates.
+        for (int c = 0; c < count; c++)
+        {
+            candidates[c].p = c == 0 ? defaults : random_parameters();
+            candidates[c].games = 0;
+            candidates[c].won = 0;
+            candidates[c].total = 0;
+            candidates[c].alive = true;
+        }
+
+        printf("%s\n%6s %10s %6s %6s %9s %12s %9s  %s\n", argv[m], "round", "candidates", "games", "won", "median", "mean", "time",
+            "best parameters");
+
+        double start = now();
+        long target = games;
+        int left = count;
+
+        for (int round = 1; ; round++)
+        {
+            double round_start = now();
+            long jobs = 0;
+
+            // The candidates left play the seeds they have not played yet.
+            for (int c = 0; c < count; c++)
+            {
+                if (!candidates[c].alive)
+                    continue;
+
+                for (long i = candidates[c].games; i < target; i++)
+                {
+                    b->jobs[jobs].candidate = c;
+                    b->jobs[jobs].seed = seed + i;
+                    jobs++;
+                }
+            }
+
+            if (!play(b, jobs, workers, candidates, map, w, h, max_rounds, original))
+            {
+                fprintf(stderr, "a worker failed, the results are incomplete\n");
+                return 1;
+            }
+
+            for (long j = 0; j < jobs; j++)
+            {
+                candidate* c = &candidates[b->jobs[j].candidate];
+
+                c->scores[b->jobs[j].seed - seed] = b->jobs[j].score;
+                c->games++;
+                c->won += b->jobs[j].outcome == SIM_WON;
+                c->total += b->jobs[j].score;
+            }
+
+            int ranked = 0;
+
+            for (int c = 0; c < count; c++)
+            {
+                if (!candidates[c].alive)
+                    continue;
+
+                memcpy(sorted, candidates[c].scores, candidates[c].games * sizeof(long));
+                qsort(sorted, candidates[c].games, sizeof(long), by_score);
+                candidates[c].median = sorted[candidates[c].games / 2];
+
+                ranking[ranked++] = &candidates[c];
+            }
+
+            qsort(ranking, ranked, sizeof(candidate*), by_results);
+
+            printf("%6d %10d %6ld %5.1f%% %9ld %12.1f %7.2f s  ", round, left, target,
+                100.0 * ranking[0]->won / ranking[0]->games, ranking[0]->median, mean(ranking[0]), (now() - round_start) / 1e9);
+            print_parameters(&ranking[0]->p);
+            printf("\n");
+
+            // Only the better half goes on, to play twice as many games, unless a single
+            // candidate is left: more games could not change the ranking anymore.
+            if (left == 1)
+                break;
+
+            left = (left + 1) / 2;
+
+            for (int i = left; i < ranked; i++)
+                ranking[i]->alive = false;
+
+            if (left == 1)
+                break;
+
+            target *= 2;
+        }
+
+        candidate* best = ranking[0];
+
+        printf("best     ");
+        print_parameters(&best->p);
+        printf(": median %ld, mean %.1f points, %.1f%% won over %ld games\n", best->median, mean(best),
+            100.0 * best->won / best->games, best->games);
+        printf("default  ");
+        print_parameters(&defaults);
+        printf(": median %ld, mean %.1f points, %.1f%% won over %ld games\n", candidates[0].median,
+            mean(&candidates[0]), 100.0 * candidates[0].won / candidates[0].games, candidates[0].games);
+        printf("%.2f s with %d workers\n\n", (now() - start) / 1e9, workers);
+
+        destroy_map(map, w, h);
+    }
+
+    munmap(b, size);
+
+    for (int c = 0; c < count; c++)
+        free(candidates[c].scores);
+
+    free(sorted);
+    free(ranking);
+    free(candidates);
+
+    return 0;
+}